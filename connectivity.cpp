@@ -0,0 +1,80 @@
+#include <algorithm>
+#include "connectivity.h"
+
+int connectivity::size() const
+{
+    return rowStart.size() - 1;
+}
+
+int connectivity::weight(int i, int j) const
+{
+    //Rows are sorted by column, so a binary search finds the entry
+    auto first = columns.begin() + rowStart[i];
+    auto last  = columns.begin() + rowStart[i+1];
+    auto it = std::lower_bound(first, last, j);
+    if(it == last || *it != j)
+        return 0;
+    return weights[it - columns.begin()];
+}
+
+connectivity buildConnectivity(int size, std::vector<connentry>& entries)
+{
+    connectivity c;
+    c.rowStart.assign(size + 1, 0);
+
+    std::sort(entries.begin(), entries.end(), [](const connentry& a, const connentry& b) {
+        return a.row != b.row ? a.row < b.row : a.column < b.column;
+    });
+
+    //Sum duplicate entries while counting how many entries each row has
+    for(const connentry& e : entries) {
+        if(!c.columns.empty() && c.rowStart[e.row+1] != 0 && c.columns.back() == e.column) {
+            c.weights.back() += e.weight;
+            continue;
+        }
+        c.columns.push_back(e.column);
+        c.weights.push_back(e.weight);
+        c.rowStart[e.row+1] += 1;
+    }
+
+    //Turn the counts into offsets
+    for(int i = 0; i != size; ++i)
+        c.rowStart[i+1] += c.rowStart[i];
+
+    return c;
+}
+
+connectivity subConnectivity(const connectivity& src, const std::vector<int>& keep)
+{
+    //Map from gates in `src` to gates in the result, or -1 if not kept
+    std::vector<int> newIndex(src.size(), -1);
+    for(unsigned i = 0; i != keep.size(); ++i)
+        newIndex[keep[i]] = i;
+
+    std::vector<connentry> entries;
+    for(unsigned i = 0; i != keep.size(); ++i) {
+        int g = keep[i];
+        for(int e = src.rowStart[g]; e != src.rowStart[g+1]; ++e) {
+            int h = newIndex[src.columns[e]];
+            if(h != -1)
+                entries.push_back(connentry{ int(i), h, src.weights[e] });
+        }
+    }
+
+    return buildConnectivity(keep.size(), entries);
+}
+
+connectivity contractConnectivity(const connectivity& src, const std::vector<int>& merged, int size)
+{
+    std::vector<connentry> entries;
+    entries.reserve(src.columns.size());
+    for(int g = 0; g != src.size(); ++g) {
+        for(int e = src.rowStart[g]; e != src.rowStart[g+1]; ++e) {
+            int h = merged[src.columns[e]];
+            if(h != merged[g])
+                entries.push_back(connentry{ merged[g], h, src.weights[e] });
+        }
+    }
+
+    return buildConnectivity(size, entries);
+}
@@ -0,0 +1,47 @@
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+#include <vector>
+
+/* Sparse connectivity of a module's gates, stored in compressed sparse row (CSR)
+ * form. The entries of row i are [rowStart[i], rowStart[i+1]) in `columns` and
+ * `weights`, sorted by column. Only non-zero connections are stored, so memory
+ * scales with the number of pins instead of gates squared. */
+
+struct connectivity
+{
+    //Offset of the first entry of each row. Has size()+1 elements
+    std::vector<int> rowStart = std::vector<int>(1, 0);
+
+    //Connected gate and number of connections for each entry
+    std::vector<int> columns;
+    std::vector<int> weights;
+
+    //Number of gates (rows) in the connectivity
+    int size() const;
+
+    //Number of connections between gates i and j; 0 if not connected
+    int weight(int i, int j) const;
+};
+
+//A single (row, column, weight) connection used to build a connectivity
+struct connentry
+{
+    int row;
+    int column;
+    int weight;
+};
+
+/* Builds a `size` gate connectivity from a list of entries. Entries with the
+ * same row and column are summed together. `entries` is sorted in the process */
+connectivity buildConnectivity(int size, std::vector<connentry>& entries);
+
+/* Builds the connectivity between only the gates in `keep`, where gate keep[i]
+ * of `src` becomes gate i of the result */
+connectivity subConnectivity(const connectivity& src, const std::vector<int>& keep);
+
+/* Builds a `size` gate connectivity where gate i of `src` is merged into gate
+ * merged[i]. Connections between merged gates are summed, and connections
+ * inside a merged gate are dropped */
+connectivity contractConnectivity(const connectivity& src, const std::vector<int>& merged, int size);
+
+#endif
@@ -0,0 +1,198 @@
+#include <fstream>
+#include <unordered_map>
+#include <map>
+#include "utility.h"
+#include "nettable.h"
+#include "eco.h"
+
+//Identifies a gate by its cell name and the nets on its pins, eg: "nand2 a b > N1"
+static std::string gateSignature(const gate_instance& gate, const MattCellFile& cells)
+{
+    std::string s = cells.name(gate.cell);
+    for(netid n : gate.inputs)
+        s.append(" ").append(nets().name(n));
+    s.append(" >");
+    for(netid n : gate.outputs)
+        s.append(" ").append(nets().name(n));
+    return s;
+}
+
+/****************************************************************************/
+
+PartitionFile::PartitionFile(const std::string& filename, const MattCellFile& cells)
+    : cellsRef(cells)
+{
+    file.open(filename, std::ios::out);
+    if(!file.is_open()) {
+        error("Could not open PartitionFile \"", filename, "\" for writing");
+    }
+}
+
+void PartitionFile::write(const std::vector<module_view>& partitions, const std::vector<polish_string>& polishes)
+{
+    if(partitions.size() != polishes.size())
+        error("PartitionFile modules and polish sizes differ");
+
+    /* The format of a partition is:
+     * .partition N
+     * .polish [Polish expression]
+     * .gate [Cell] [Input nets] > [Output nets]
+     * ...
+     * .end
+     */
+    for(unsigned i = 0; i != partitions.size(); ++i)
+    {
+        file << ".partition " << i << '\n';
+        file << ".polish";
+        for(const std::string& entry : polishes[i])
+            file << " " << entry;
+        file << '\n';
+        for(int g : partitions[i].gates)
+            file << ".gate " << gateSignature(partitions[i].netlist->gates[g], cellsRef) << '\n';
+        file << ".end" << std::endl;
+    }
+}
+
+std::vector<partition_record> readPartitionFile(const std::string& filename)
+{
+    std::vector<partition_record> records;
+    MappedFile file(filename);
+    if(!file.isOpen()) {
+        error("Could not open partition file \"", filename, "\"");
+    }
+
+    LineTokenizer lines(file.begin(), file.end());
+    std::vector<string_ref> tokens;
+    int lineCount = 0, linesRead;
+    while(lines.next(tokens, linesRead))
+    {
+        lineCount += linesRead;
+        if(tokens.empty())
+            continue;
+        const string_ref& keyword = tokens[0];
+
+        if(keyword == ".partition") {
+            records.emplace_back();
+            continue;
+        }
+        if(!(keyword == ".polish" || keyword == ".gate"))
+            continue;
+        if(records.empty()) {
+            error(filename, ":", lineCount, ": ", keyword, " before any .partition");
+        }
+
+        if(keyword == ".polish") {
+            for(unsigned i = 1; i < tokens.size(); ++i)
+                records.back().polish.push_back(tokens[i].str());
+        } else {
+            std::string signature = tokens.size() > 1 ? tokens[1].str() : "";
+            for(unsigned i = 2; i < tokens.size(); ++i)
+                signature.append(" ").append(tokens[i].data, tokens[i].size);
+            records.back().gates.push_back(signature);
+        }
+    }
+
+    return records;
+}
+
+/****************************************************************************/
+
+int ecoPartitionAndFloorplan(const module& m, const MattCellFile& cells, const PadframeFile& f,
+    const PartitionOptions& options, const FloorplanOptions& floorplanOptions,
+    const std::vector<partition_record>& previous,
+    std::vector<module_view>& partitions, std::vector<polish_string>& polishes)
+{
+    int nGates = m.gates.size();
+
+    //Gates of `m` by signature, not yet matched to a saved partition. Lowest index last
+    std::unordered_map<std::string, std::vector<int>> unmatched;
+    for(int g = nGates - 1; g >= 2; --g)
+        unmatched[gateSignature(m.gates[g], cells)].push_back(g);
+
+    /* Match each saved partition's gates to gates of `m`, in their saved order so
+     * the saved polish still applies. A partition is touched if any gate is gone */
+    std::vector<std::vector<int>> gateLists(previous.size());
+    std::vector<char> touched(previous.size(), 0);
+    std::vector<int> owner(nGates, -1);
+    for(unsigned p = 0; p != previous.size(); ++p) {
+        for(const std::string& signature : previous[p].gates) {
+            auto it = unmatched.find(signature);
+            if(it == unmatched.end() || it->second.empty()) {
+                touched[p] = 1;
+                continue;
+            }
+            int g = it->second.back();
+            it->second.pop_back();
+            gateLists[p].push_back(g);
+            owner[g] = p;
+        }
+    }
+
+    //New gates join the partition they share the most nets with, or the smallest one
+    const hypergraph& h = m.hyperedges;
+    for(int g = 2; g < nGates && !previous.empty(); ++g) {
+        if(owner[g] != -1)
+            continue;
+        std::map<int,int> shared;
+        for(int i = h.gateStart[g]; i != h.gateStart[g+1]; ++i) {
+            int e = h.gateNets[i];
+            for(int p = h.netStart[e]; p != h.netStart[e+1]; ++p)
+                if(owner[h.pins[p]] != -1)
+                    shared[owner[h.pins[p]]] += 1;
+        }
+        int best = 0, bestShared = 0;
+        for(const auto& entry : shared) {
+            if(entry.second > bestShared) {
+                best = entry.first;
+                bestShared = entry.second;
+            }
+        }
+        if(shared.empty()) {
+            for(unsigned p = 0; p != gateLists.size(); ++p)
+                if(gateLists[p].size() < gateLists[best].size())
+                    best = p;
+        }
+        gateLists[best].push_back(g);
+        owner[g] = best;
+        touched[best] = 1;
+    }
+
+    /* Untouched partitions keep their polish. Touched partitions are partitioned
+     * again in case they grew past a slice, and are floorplanned afterwards */
+    int reused = 0;
+    std::vector<module_view> redo;
+    std::vector<int> redoIndex;
+    for(unsigned p = 0; p != previous.size(); ++p) {
+        if(gateLists[p].empty())
+            continue;
+        module_view partition{ &m, std::move(gateLists[p]) };
+        if(!touched[p]) {
+            partitions.push_back(std::move(partition));
+            polishes.push_back(previous[p].polish);
+            ++reused;
+            continue;
+        }
+        for(module_view& part : kerninghanLinPadframeSlice(partition, f, options)) {
+            redoIndex.push_back(partitions.size());
+            partitions.push_back(part);
+            polishes.emplace_back();
+            redo.push_back(std::move(part));
+        }
+    }
+
+    //Nothing to reuse; this is a full run
+    if(previous.empty()) {
+        redo = kerninghanLinPadframeSlice(m, f, options);
+        for(const module_view& part : redo) {
+            redoIndex.push_back(partitions.size());
+            partitions.push_back(part);
+            polishes.emplace_back();
+        }
+    }
+
+    std::vector<polish_string> redoPolishes = floorplan_all(redo, floorplanOptions);
+    for(unsigned i = 0; i != redo.size(); ++i)
+        polishes[redoIndex[i]] = std::move(redoPolishes[i]);
+
+    return reused;
+}
@@ -0,0 +1,51 @@
+#ifndef ECO_H
+#define ECO_H
+#include <string>
+#include <vector>
+#include <fstream>
+#include "module.h"
+#include "padframe.h"
+#include "floorplan.h"
+#include "kerninghan.h"
+
+/* Engineering change order (ECO) support. A run saves which gates went into
+ * each partition and the partition's polish expression to a PartitionFile.
+ * After a small edit to the .netblif, ecoPartitionAndFloorplan reuses every
+ * partition the edit did not touch, and only re-partitions and re-floorplans
+ * the rest. Netlists have no instance names, so a gate is identified by its
+ * cell name and the nets on its pins. */
+
+//The gates (by signature) and polish expression of one saved partition
+struct partition_record
+{
+    std::vector<std::string> gates;
+    polish_string polish;
+};
+
+class PartitionFile
+{
+public:
+    PartitionFile(const std::string& filename, const MattCellFile& cells);
+
+    //Writes the partitions' gates along with their polishes
+    void write(const std::vector<module_view>& partitions, const std::vector<polish_string>& polishes);
+
+private:
+    std::ofstream file;
+    const MattCellFile& cellsRef;
+};
+
+//Reads back the partitions written by a PartitionFile
+std::vector<partition_record> readPartitionFile(const std::string& filename);
+
+/* Partitions and floorplans `m`, read with `cells`, given the partitions of a previous
+ * run. Partitions whose gates are all still in `m` keep their gate order and polish
+ * expression. New gates join the partition they share the most nets with. Partitions
+ * that lost or gained gates are re-partitioned and re-floorplanned with
+ * `floorplanOptions`. Returns the number of reused partitions */
+int ecoPartitionAndFloorplan(const module& m, const MattCellFile& cells, const PadframeFile& f,
+    const PartitionOptions& options, const FloorplanOptions& floorplanOptions,
+    const std::vector<partition_record>& previous,
+    std::vector<module_view>& partitions, std::vector<polish_string>& polishes);
+
+#endif
@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "fiduccia.h"
+
+#define FM_MAX_FRUITLESS_MOVES  1000    //A pass stops after this many moves without a new best cut
+
+//Type definitions used in this file
+typedef std::vector<int> vint;
+
+/* Gates of one side bucketed by gain. Each bucket is a doubly linked list
+ * threaded through `next` and `prev`, so inserting, removing and changing the
+ * gain of a gate are O(1), and the best gate is found from the highest bucket */
+class GainBuckets
+{
+public:
+    GainBuckets(int numGates, int maxGain)
+        : maxGain(maxGain), top(-1), head(2*maxGain + 1, -1),
+          next(numGates, -1), prev(numGates, -1), gains(numGates, 0) { }
+
+    void insert(int g, int gain)
+    {
+        int b = gain + maxGain;
+        gains[g] = gain;
+        prev[g] = -1;
+        next[g] = head[b];
+        if(head[b] != -1)
+            prev[head[b]] = g;
+        head[b] = g;
+        top = std::max(top, b);
+    }
+
+    void remove(int g)
+    {
+        int b = gains[g] + maxGain;
+        if(prev[g] != -1)
+            next[prev[g]] = next[g];
+        else
+            head[b] = next[g];
+        if(next[g] != -1)
+            prev[next[g]] = prev[g];
+    }
+
+    void update(int g, int delta)
+    {
+        remove(g);
+        insert(g, gains[g] + delta);
+    }
+
+    int gain(int g) const
+    {
+        return gains[g];
+    }
+
+    //Highest gain gate for which `allowed` is true, or -1 if there is none
+    template<class Predicate>
+    int best(Predicate allowed)
+    {
+        while(top >= 0 && head[top] == -1)
+            --top;
+        for(int b = top; b >= 0; --b)
+            for(int g = head[b]; g != -1; g = next[g])
+                if(allowed(g))
+                    return g;
+        return -1;
+    }
+
+private:
+    int  maxGain;
+    int  top;   //No bucket above `top` holds a gate
+    vint head;  //First gate of each gain bucket
+    vint next;
+    vint prev;
+    vint gains;
+};
+
+/* Gains on the connectivity matrix: moving a gate gains the weight of its
+ * connections to the other side, and loses the weight of those on its own side */
+class ConnectivityGains
+{
+public:
+    ConnectivityGains(const connectivity& matrix) : matrix(matrix) { }
+
+    int numGates() const
+    {
+        return matrix.size();
+    }
+
+    int maxGain() const
+    {
+        int most = 0;
+        for(int g = 0; g != matrix.size(); ++g)
+            most = std::max(most, std::accumulate(matrix.weights.begin() + matrix.rowStart[g],
+                                                   matrix.weights.begin() + matrix.rowStart[g+1], 0));
+        return most;
+    }
+
+    //Gains are read straight from the matrix, so there is no state to set up
+    void init(const vint&)
+    {
+    }
+
+    int gain(int g, const vint& side) const
+    {
+        int total = 0;
+        for(int e = matrix.rowStart[g]; e != matrix.rowStart[g+1]; ++e)
+            if(matrix.columns[e] != g)
+                total += side[matrix.columns[e]] != side[g] ? matrix.weights[e] : -matrix.weights[e];
+        return total;
+    }
+
+    //Calls `change(x, delta)` for every gate whose gain changes when `moved` leaves side `from`
+    template<class Change>
+    void move(int moved, int from, const vint& side, Change change)
+    {
+        for(int e = matrix.rowStart[moved]; e != matrix.rowStart[moved+1]; ++e) {
+            int x = matrix.columns[e];
+            if(x != moved)
+                change(x, side[x] == from ? 2*matrix.weights[e] : -2*matrix.weights[e]);
+        }
+    }
+
+private:
+    const connectivity& matrix;
+};
+
+/* Gains on the net hypergraph: moving a gate uncuts every net it is the last pin
+ * of on its side, and cuts every net that had no pins on the other side */
+class HypergraphGains
+{
+public:
+    HypergraphGains(const hypergraph& nets) : nets(nets) { }
+
+    int numGates() const
+    {
+        return nets.numGates();
+    }
+
+    int maxGain() const
+    {
+        int most = 0;
+        for(int g = 0; g != nets.numGates(); ++g)
+            most = std::max(most, nets.gateStart[g+1] - nets.gateStart[g]);
+        return most;
+    }
+
+    void init(const vint& side)
+    {
+        for(int s = 0; s != 2; ++s)
+            pinsOnSide[s].assign(nets.numNets(), 0);
+        for(int e = 0; e != nets.numNets(); ++e)
+            for(int p = nets.netStart[e]; p != nets.netStart[e+1]; ++p)
+                pinsOnSide[side[nets.pins[p]]][e] += 1;
+    }
+
+    int gain(int g, const vint& side) const
+    {
+        int total = 0;
+        for(int i = nets.gateStart[g]; i != nets.gateStart[g+1]; ++i) {
+            int e = nets.gateNets[i];
+            total += (pinsOnSide[side[g]][e] == 1) - (pinsOnSide[1 - side[g]][e] == 0);
+        }
+        return total;
+    }
+
+    /* The classic FM update: only nets whose pin count on either side is near zero
+     * change any gains, and of those only a single pin's gain for counts of one */
+    template<class Change>
+    void move(int moved, int from, const vint& side, Change change)
+    {
+        int to = 1 - from;
+        for(int i = nets.gateStart[moved]; i != nets.gateStart[moved+1]; ++i) {
+            int e = nets.gateNets[i];
+            int first = nets.netStart[e], last = nets.netStart[e+1];
+
+            //Before the move: the net becomes cut, or stops being critical on `to`
+            if(pinsOnSide[to][e] == 0) {
+                for(int p = first; p != last; ++p)
+                    if(nets.pins[p] != moved)
+                        change(nets.pins[p], 1);
+            } else if(pinsOnSide[to][e] == 1) {
+                for(int p = first; p != last; ++p)
+                    if(side[nets.pins[p]] == to)
+                        change(nets.pins[p], -1);
+            }
+
+            pinsOnSide[from][e] -= 1;
+            pinsOnSide[to][e]   += 1;
+
+            //After the move: the net is uncut, or its last pin on `from` is now critical
+            if(pinsOnSide[from][e] == 0) {
+                for(int p = first; p != last; ++p)
+                    if(nets.pins[p] != moved)
+                        change(nets.pins[p], -1);
+            } else if(pinsOnSide[from][e] == 1) {
+                for(int p = first; p != last; ++p)
+                    if(nets.pins[p] != moved && side[nets.pins[p]] == from)
+                        change(nets.pins[p], 1);
+            }
+        }
+    }
+
+private:
+    const hypergraph& nets;
+    vint pinsOnSide[2];
+};
+
+template<class Gains>
+class FiducciaMattheysesSolver
+{
+public:
+    FiducciaMattheysesSolver(Gains gains, const vint& weights, vint& side, float balance, const vint& pull)
+        : gains(gains), weights(weights), side(side), pull(pull)
+    {
+        int n = gains.numGates();
+        if(this->weights.empty())
+            this->weights.assign(n, 1);
+
+        //Each side may be off half of the total by the balance, but at least by the heaviest gate
+        int total = 0, heaviest = 0;
+        lightest = n ? this->weights[0] : 0;
+        for(int w : this->weights) {
+            total += w;
+            heaviest = std::max(heaviest, w);
+            lightest = std::min(lightest, w);
+        }
+        int slack = std::max<int>(std::ceil(balance * total), heaviest);
+        minSide = std::max(1, total/2 - slack);
+        maxSide = total - minSide;
+
+        solve();
+    }
+
+private:
+    Gains gains;
+    vint  weights;
+    vint& side;
+    const vint& pull;
+    vint  locked;
+    int   minSide;
+    int   maxSide;
+    int   lightest;
+    int   sideWeight[2];
+
+private:
+    bool canMove(int g) const
+    {
+        int from = side[g];
+        return sideWeight[from] - weights[g] >= minSide && sideWeight[1 - from] + weights[g] <= maxSide;
+    }
+
+    //Whether any gate could leave side `s`, so its gain bucket needs looking at
+    bool canMoveFrom(int s) const
+    {
+        return sideWeight[s] - lightest >= minSide && sideWeight[1 - s] + lightest <= maxSide;
+    }
+
+    //Gain of moving `g` towards the side its terminals pull it to, if there are any
+    int bonus(int g) const
+    {
+        return pull.empty() ? 0 : (side[g] == 0 ? pull[g] : -pull[g]);
+    }
+
+    int imbalance() const
+    {
+        return std::abs(sideWeight[0] - sideWeight[1]);
+    }
+
+    //One FM pass. Returns the improvement in cut that was kept
+    int pass()
+    {
+        int n = gains.numGates();
+        int maxPull = 0;
+        for(int p : pull)
+            maxPull = std::max(maxPull, std::abs(p));
+        int maxGain = gains.maxGain() + maxPull;
+        GainBuckets buckets[2] = { GainBuckets(n, maxGain), GainBuckets(n, maxGain) };
+
+        gains.init(side);
+        locked.assign(n, 0);
+        sideWeight[0] = sideWeight[1] = 0;
+        for(int g = 0; g != n; ++g) {
+            sideWeight[side[g]] += weights[g];
+            buckets[side[g]].insert(g, gains.gain(g, side) + bonus(g));
+        }
+
+        /* Move every gate once, remembering the point with the best total gain. Moves
+         * far past the best point are almost always undone, so the pass ends early */
+        vint moves;
+        int sum = 0, bestSum = 0, bestMoves = 0, bestImbalance = imbalance();
+        auto allowed = [this](int g) { return canMove(g); };
+        while(1)
+        {
+            int g0 = canMoveFrom(0) ? buckets[0].best(allowed) : -1;
+            int g1 = canMoveFrom(1) ? buckets[1].best(allowed) : -1;
+            if(g0 == -1 && g1 == -1)
+                break;
+
+            //Take the higher gain move, or the one from the heavier side on ties
+            int g;
+            if(g0 == -1 || g1 == -1)
+                g = (g0 == -1) ? g1 : g0;
+            else if(buckets[0].gain(g0) != buckets[1].gain(g1))
+                g = buckets[0].gain(g0) > buckets[1].gain(g1) ? g0 : g1;
+            else
+                g = sideWeight[0] >= sideWeight[1] ? g0 : g1;
+
+            int from = side[g];
+            sum += buckets[from].gain(g);
+            buckets[from].remove(g);
+            locked[g] = 1;
+            gains.move(g, from, side, [&](int x, int delta) {
+                if(!locked[x])
+                    buckets[side[x]].update(x, delta);
+            });
+            side[g] = 1 - from;
+            sideWeight[from] -= weights[g];
+            sideWeight[1 - from] += weights[g];
+            moves.push_back(g);
+
+            if(sum > bestSum || (sum == bestSum && imbalance() < bestImbalance)) {
+                bestSum = sum;
+                bestMoves = moves.size();
+                bestImbalance = imbalance();
+            }
+            if(int(moves.size()) - bestMoves > FM_MAX_FRUITLESS_MOVES)
+                break;
+        }
+
+        //Undo the moves after the best point
+        for(int i = moves.size() - 1; i >= bestMoves; --i)
+            side[moves[i]] = 1 - side[moves[i]];
+        return bestSum;
+    }
+
+    /* Moves gates off a side heavier than the balance allows, best gains first, so
+     * that passes start from a balanced partition. Gains are not updated as gates
+     * move, which is close enough for a starting point */
+    void repair()
+    {
+        sideWeight[0] = sideWeight[1] = 0;
+        for(int g = 0; g != gains.numGates(); ++g)
+            sideWeight[side[g]] += weights[g];
+
+        for(int s = 0; s != 2; ++s) {
+            if(sideWeight[s] <= maxSide)
+                continue;
+            gains.init(side);
+            std::vector<std::pair<int,int>> order;
+            for(int g = 0; g != gains.numGates(); ++g)
+                if(side[g] == s)
+                    order.emplace_back(-gains.gain(g, side) - bonus(g), g);
+            std::sort(order.begin(), order.end());
+
+            for(const auto& entry : order) {
+                int g = entry.second;
+                if(sideWeight[s] <= maxSide)
+                    break;
+                if(sideWeight[1 - s] + weights[g] > maxSide)
+                    continue;
+                side[g] = 1 - s;
+                sideWeight[s] -= weights[g];
+                sideWeight[1 - s] += weights[g];
+            }
+        }
+    }
+
+    void solve()
+    {
+        if(gains.numGates() < 2)
+            return;
+        repair();
+        while(pass() > 0)
+            ;
+    }
+};
+
+/************************************************************************/
+
+//Splits `side` into the gate lists of sides 0 and 1
+static std::pair<vint,vint> splitSides(const vint& side)
+{
+    std::pair<vint,vint> result;
+    for(int g = 0; g != int(side.size()); ++g)
+        (side[g] == 0 ? result.first : result.second).push_back(g);
+    return result;
+}
+
+//Starts from the same halves as KL: the first half of the gates in A, the rest in B
+static vint initialSides(int n)
+{
+    vint side(n, 1);
+    std::fill(side.begin(), side.begin() + n/2, 0);
+    return side;
+}
+
+std::pair<vint,vint> fiducciaMattheysesSolve(const connectivity& matrix, const vint& weights, float balance, const vint& pull)
+{
+    vint side = initialSides(matrix.size());
+    fiducciaMattheysesRefine(matrix, weights, side, balance, pull);
+    return splitSides(side);
+}
+
+std::pair<vint,vint> fiducciaMattheysesSolve(const hypergraph& nets, const vint& weights, float balance, const vint& pull)
+{
+    vint side = initialSides(nets.numGates());
+    fiducciaMattheysesRefine(nets, weights, side, balance, pull);
+    return splitSides(side);
+}
+
+void fiducciaMattheysesRefine(const connectivity& matrix, const vint& weights, vint& side, float balance, const vint& pull)
+{
+    FiducciaMattheysesSolver<ConnectivityGains>(ConnectivityGains(matrix), weights, side, balance, pull);
+}
+
+void fiducciaMattheysesRefine(const hypergraph& nets, const vint& weights, vint& side, float balance, const vint& pull)
+{
+    FiducciaMattheysesSolver<HypergraphGains>(HypergraphGains(nets), weights, side, balance, pull);
+}
@@ -0,0 +1,33 @@
+#ifndef FIDUCCIA_MATTHEYSES_H
+#define FIDUCCIA_MATTHEYSES_H
+#include <vector>
+#include <utility>
+#include "connectivity.h"
+#include "hypergraph.h"
+
+/* Implementation of the Fiduccia-Mattheyses two-way partitioning algorithm.
+ * Gates are moved one at a time, always taking the highest gain move that keeps
+ * both sides within `balance` (a fraction of the total gate weight) of half of it.
+ * Gains are kept in bucket lists, so each pass is linear in the number of pins.
+ * Input: The gate connections, or the net hypergraph to count cut nets on, and
+ *        the gate weights to balance, or an empty vector to weigh every gate as 1.
+ *        Optionally the pull of fixed terminals outside the gates on each gate:
+ *        a move towards B gains pull[g] and a move towards A loses it
+ * Output: The gates of partition A and of partition B */
+
+std::pair<std::vector<int>,std::vector<int>> fiducciaMattheysesSolve(const connectivity& matrix,
+    const std::vector<int>& weights, float balance, const std::vector<int>& pull = std::vector<int>());
+std::pair<std::vector<int>,std::vector<int>> fiducciaMattheysesSolve(const hypergraph& nets,
+    const std::vector<int>& weights, float balance, const std::vector<int>& pull = std::vector<int>());
+
+/* Improves an existing partition with FM passes. `side` holds 0 or 1 for every
+ * gate and is updated in place. Gate weights count towards the balance; an
+ * empty `weights` weighs every gate as 1. A side over the balance is first
+ * evened out by moving its best gain gates off it */
+
+void fiducciaMattheysesRefine(const connectivity& matrix, const std::vector<int>& weights,
+    std::vector<int>& side, float balance, const std::vector<int>& pull = std::vector<int>());
+void fiducciaMattheysesRefine(const hypergraph& nets, const std::vector<int>& weights,
+    std::vector<int>& side, float balance, const std::vector<int>& pull = std::vector<int>());
+
+#endif
@@ -1,11 +1,14 @@
 #include <vector>
 #include <stack>
-#include <future>
 #include <string>
+#include <cstdlib>
+#include <algorithm>
 #include "floorplan.h"
 #include "floorplan_citizen.h"
 #include "genetic_algorithm.h"
 #include "utility.h"
+#include "threadpool.h"
+#include "kerninghan.h"
 
 //Floorplan genetic algorithm derivation
 class FloorplanGenetic : public GeneticAlgorithm<floorplan_citizen>
@@ -22,82 +25,123 @@ public:
         this->gates = gates;
     }
 
+    //Sets how the citizens are measured
+    void setOptions(const FloorplanOptions& options)
+    {
+        this->options = options;
+    }
+
 protected:
     void init_population(population& pop) override
     {
         if(gates == nullptr)
             error("Floorplan algorithm called with no gates");
         for(floorplan_citizen& citizen : pop) {
-            citizen.initialize(this->gates);
+            citizen.initialize(this->gates, options.metric);
         }
     }
 
     void calc_fitness(population& pop) override
     {
-        for(floorplan_citizen& citizen : pop)
-            citizen.calc_fitness();
+        for_each_citizen(pop, [](floorplan_citizen& citizen) { citizen.calc_fitness(); });
     }
 
     void mate(floorplan_citizen& child,
         const floorplan_citizen& mom,
-        const floorplan_citizen& dad) override
+        const floorplan_citizen& dad,
+        random_engine& rng) override
     {
-        child = (rand() % 1) ? mom : dad;
+        child = (rng() % 1) ? mom : dad;
     }
 
-    void mutate(floorplan_citizen& member) override
+    void mutate(floorplan_citizen& member, random_engine& rng) override
     {
-        member.mutate();
+        member.mutate(rng);
     }
 
 private:
     //The gates the form a floorplan over.
     module* gates = nullptr;
+
+    FloorplanOptions options;
 };
 
 
 /******************************************************/
 
-polish_string floorplan(module& partition)
+polish_string floorplan(module& partition, const FloorplanOptions& options)
 {
     FloorplanGenetic algo;
     algo.setGates(&partition);
+    algo.setOptions(options);
+    algo.setFitnessThreads(options.fitnessThreads);
     return algo.go().getPolish();
 }
 
+polish_string floorplan(const module_view& partition, const FloorplanOptions& options)
+{
+    module gates = extractModule(partition);
+    return floorplan(gates, options);
+}
+
 polish_string floorplan_ptr(module* partitionPtr)
 {
     auto result = floorplan(*partitionPtr);
     return result;
 }
 
-std::vector<polish_string> floorplan_all(std::vector<module>& modules, unsigned batchSize)
+//Options each of `partitions` partitions floorplanned at once is given
+static FloorplanOptions sharedOptions(size_t partitions, const FloorplanOptions& options)
 {
-    std::vector<polish_string> results;
-    std::vector<std::future<polish_string>> futures;
-
-    /* Loop for each module and start a thread for it. If we are running `batchSize` threads,
-     * stop and wait for them all. In the case there is a remainder of threads (< batchSize),
-     * they are handled by waiting for all remaining threads outside the loop */
-    for(module& m : modules) {
-        futures.push_back(std::async(std::launch::async, floorplan_ptr, &m));
-        if(futures.size() >= batchSize) {
-            for(auto& thread : futures) {
-                results.push_back(thread.get());
-            }
-            futures.clear();
-        }
-    }
+    //Cores the partitions would leave idle go to splitting up each one's generations
+    FloorplanOptions shared = options;
+    unsigned cores = threadPool().size();
+    if(partitions != 0 && partitions < cores)
+        shared.fitnessThreads = std::max<unsigned>(options.fitnessThreads, cores / partitions);
+    return shared;
+}
 
-    /* Catches the remainder threads, in the case of the loop ending and
-     * "futures.size() >= batchSize" not triggering */
-    for(auto& thread : futures) {
-        results.push_back(thread.get());
+std::vector<polish_string> floorplan_all(const std::vector<module_view>& partitions,
+    const FloorplanOptions& options)
+{
+    std::vector<polish_string> results(partitions.size());
+    FloorplanOptions shared = sharedOptions(partitions.size(), options);
+
+    /* Each partition is a task on the shared pool, which partitioning also runs on.
+     * A partition's gates are copied out in its task, so only the partitions being
+     * floorplanned at the time are ever held as whole modules */
+    TaskGroup group;
+    for(unsigned i = 0; i != partitions.size(); ++i) {
+        const module_view* partition = &partitions[i];
+        polish_string* result = &results[i];
+        group.run([partition, result, &shared]() { *result = floorplan(*partition, shared); });
     }
+    group.wait();
 
     return results;
 }
 
+slicing_cost floorplanCost(const module_view& partition, const polish_string& polish,
+    const FloorplanOptions& options)
+{
+    std::vector<int> tokens;
+    tokens.reserve(polish.size());
+    for(const std::string& entry : polish) {
+        if(entry == "H")
+            tokens.push_back(POLISH_H);
+        else if(entry == "V")
+            tokens.push_back(POLISH_V);
+        else
+            tokens.push_back(atoi(entry.c_str()));
+    }
+
+    module gates = extractModule(partition);
+    SlicingTree tree;
+    if(!tree.evaluate(tokens, gates, options.metric))
+        error("Polish expression is not a slicing floorplan of its partition");
+    return tree.cost();
+}
+
 
 #if 0
 //Floorplan test main
@@ -116,3 +160,75 @@ int main()
     }
 }
 #endif
+
+#ifdef FLOORPLAN_POOL_TEST
+/* Pooled generations test main. Build with -DFLOORPLAN_POOL_TEST and every file but
+ * main.cpp, and run as: <program> <stdcell file> <module file> <padframe file>
+ * Floorplans the first padframe slice of the first model twice: with the options
+ * floorplan_all gives a lone partition, and with its generations split over 4
+ * tasks. Prints how many mutations ran on pool threads. Fails if the split run
+ * kept every mutation on the calling thread, or the two floorplans differ */
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+//Counts the mutations made on each thread
+class CountingGenetic : public FloorplanGenetic
+{
+public:
+    std::map<std::thread::id, int> mutations;
+
+protected:
+    void mutate(floorplan_citizen& member, random_engine& rng) override
+    {
+        {
+            std::lock_guard<std::mutex> hold(lock);
+            mutations[std::this_thread::get_id()] += 1;
+        }
+        FloorplanGenetic::mutate(member, rng);
+    }
+
+private:
+    std::mutex lock;
+};
+
+int main(int argc, char** argv)
+{
+    if(argc < 4) {
+        std::cout << "Usage: " << argv[0] << " <stdcell file> <module file> <padframe file>" << std::endl;
+        return 1;
+    }
+    MattCellFile cells(argv[1]);
+    std::vector<module> modules = readModuleFile(argv[2], cells);
+    PadframeFile f(argv[3]);
+    module slice = extractModule(kerninghanLinPadframeSlice(modules[0], f).front());
+
+    FloorplanOptions split;
+    split.fitnessThreads = 4;
+    std::vector<FloorplanOptions> runs = { sharedOptions(1, FloorplanOptions()), split };
+
+    std::vector<polish_string> polishes;
+    int pooled = 0;
+    for(const FloorplanOptions& options : runs) {
+        srand(1);
+        CountingGenetic algo;
+        algo.setGates(&slice);
+        algo.setOptions(options);
+        algo.setFitnessThreads(options.fitnessThreads);
+        polishes.push_back(algo.go().getPolish());
+
+        int here = 0;
+        pooled = 0;
+        for(const auto& entry : algo.mutations)
+            (entry.first == std::this_thread::get_id() ? here : pooled) += entry.second;
+        std::cout << slice.gates.size() - 2 << " gates, " << options.fitnessThreads << " tasks, "
+                  << threadPool().size() << " pool threads: " << here << " mutations on the calling thread, "
+                  << pooled << " on pool threads" << std::endl;
+    }
+
+    bool same = (polishes[0] == polishes[1]);
+    std::cout << (same ? "Same floorplan on every run" : "Floorplans differ") << std::endl;
+    return (same && pooled > 0) ? 0 : 1;
+}
+#endif
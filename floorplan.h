@@ -1,6 +1,7 @@
 #ifndef FLOORPLAN_H
 #define FLOORPLAN_H
 #include "module.h"
+#include "slicing_tree.h"
 
 /* VLSI Floorplanning Implementation
  * Input: A module to perform floorplanning on
@@ -9,13 +10,34 @@
 
 typedef std::vector<std::string> polish_string;
 
+//Options for how modules are floorplanned
+struct FloorplanOptions
+{
+    //How wire length is measured in the fitness, next to the floorplan's area
+    WireMetric metric = WireMetric::Connections;
+
+    /* Tasks each generation's children and fitness evaluation may be split over.
+     * floorplan_all raises this to share the thread pool's cores out when there
+     * are fewer partitions than cores */
+    unsigned fitnessThreads = 1;
+};
+
 //Floorplan a single module
-polish_string floorplan(module& partition);
+polish_string floorplan(module& partition, const FloorplanOptions& options = FloorplanOptions());
+
+//Floorplan the gates of a view, which are only copied out of the netlist for the run
+polish_string floorplan(const module_view& partition, const FloorplanOptions& options = FloorplanOptions());
 
 //Pointer version for threading (calls "floorplan")
 polish_string floorplan_ptr(module* partitionPtr);
 
-//Uses multithreading to floorplan all modules in `modules`
-std::vector<polish_string> floorplan_all(std::vector<module>& modules, unsigned batchSize = 20);
+//Floorplans all partitions in `partitions` in parallel on the shared thread pool
+std::vector<polish_string> floorplan_all(const std::vector<module_view>& partitions,
+    const FloorplanOptions& options = FloorplanOptions());
+
+/* Area and wire length of a partition floorplanned as `polish`, measured the way the
+ * floorplanner does. Errors if the polish is not a slicing tree over the partition */
+slicing_cost floorplanCost(const module_view& partition, const polish_string& polish,
+    const FloorplanOptions& options = FloorplanOptions());
 
 #endif
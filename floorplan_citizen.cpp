@@ -3,31 +3,35 @@
 #include <string>
 #include <cstdlib>
 #include <string>
-#include <queue>
 #include "utility.h"
 #include "floorplan_citizen.h"
 
+#define FP_AREA_WEIGHT      1       //Weight of the floorplan's bounding box area in the fitness
+#define FP_WIRE_WEIGHT      1       //Weight of the total wire length in the fitness
+
 //Temporary fix for MinGW to_string
 std::string to_string(int i) { std::stringstream ss; ss << i; return ss.str(); }
 
-void floorplan_citizen::initialize(module* gates)
+void floorplan_citizen::initialize(module* gates, WireMetric metric)
 {
     this->gates = gates;
+    this->metric = metric;
+    evaluated = false;
 
 	//Make an initial polish string of all things vertical.
 	//Ex: 12V3V4V5V...
     int size = gates->gates.size()-2;   //-2 to account for I/O gates...
     polish.clear();
     if(size > 1) {
-		polish.push_back("0");
-		polish.push_back("1");
-		polish.push_back("V");
+		polish.push_back(0);
+		polish.push_back(1);
+		polish.push_back(V);
         for(int i = 2; i < size; ++i) {
-			polish.push_back(to_string(i));
-            polish.push_back(rand()%2 ? "V" : "H");
+			polish.push_back(i);
+            polish.push_back(rand()%2 ? V : H);
         }
     } else if(size == 1){
-        polish.push_back("0");   //Only one gate
+        polish.push_back(0);   //Only one gate
     } else {
         //0 gates
     }
@@ -37,21 +41,28 @@ void floorplan_citizen::initialize(module* gates)
 	opCounts.resize(polish.size());
 	int seenops = 0;
 	for(unsigned i=0; i!=polish.size(); ++i) {
-		if(polish[i] == "H" || polish[i] == "V")
+		if(isOperator(polish[i]))
 			++seenops;
 		opCounts[i] = seenops;
 	}
 
-	//Create initial adjacency graph
-    generateAdjacencyGraph();
-
     //Initial high fitness
     fitness = 99;
 }
 
 std::vector<std::string> floorplan_citizen::getPolish()
 {
-    return polish;
+    std::vector<std::string> text;
+    text.reserve(polish.size());
+    for(int token : polish) {
+        if(token == H)
+            text.push_back("H");
+        else if(token == V)
+            text.push_back("V");
+        else
+            text.push_back(to_string(token));
+    }
+    return text;
 }
 
 /********************************************************/
@@ -60,96 +71,62 @@ std::vector<std::string> floorplan_citizen::getPolish()
 
 void floorplan_citizen::calc_fitness()
 {
-    /* If the adjacendy graph is not valid, the fitness is infinite. These will
-     * not continue to the next generation */
-    if(!adjgraphValid) {
-       fitness = 0xDEADBEEF;
-    } else {
-        /* Otherwise, we calculate the distances from each vertex to each
-         * other vertex, and sum the distances */
-        fitness = 0;
-        for(unsigned vertex = 0; vertex != adjgraph.size(); ++vertex) {
-            auto distances = shortestPaths(vertex);
-            for(unsigned connection = 0; connection != adjgraph.size(); ++connection) {
-                fitness += distances[connection] * gates->connections[vertex][connection];
-            }
-        }
+    //Mutations keep the tree up to date, so only new citizens are evaluated in full
+    if(!evaluated) {
+        tree.evaluate(polish, *gates, metric);
+        evaluated = true;
     }
-}
-
-int floorplan_citizen::gateDistance(int g0, int g1, char c)
-{
-    //+2 accounts for 0 and 1 being "hidden" I/O gates. Ex gate 0 is actually gate 2
-    const auto& gt = gates->gates;
-    return c == 'H' ?
-        (gt[g0+2].length + gt[g1+2].length)/2 :
-        (gt[g0+2].width  + gt[g1+2].width)/2;
-    return 0;
-}
 
-std::vector<int> floorplan_citizen::shortestPaths(int start)
-{
-    int n = adjgraph.size();					// number of vertices
-    std::vector<int> distLabel(n, 999999);      // distance from start vertex
-    std::queue<int> vertexQueue;                 // queue of vertices
-
-    //TODO: Distances using gate lengths/widths (possibly)
-
-    distLabel[start] = 0;
-    for(int i = 0; i != n; ++i)
-        vertexQueue.push(i);
-
-    while (!vertexQueue.empty()) {
-        int vertex = vertexQueue.front();
-        vertexQueue.pop();
-        for(auto it = adjgraph[vertex].begin(); it != adjgraph[vertex].end(); it++) {
-            if(*it == '-')  //Skip empty connections
-                continue;
-            int neighbor = it - adjgraph[vertex].begin();
-            int newDist = distLabel[vertex] + gateDistance(vertex, neighbor, *it);
-            if(newDist < distLabel[neighbor])
-                distLabel[neighbor] = newDist;
-        }
+    /* If the polish is not a valid slicing tree, the fitness is infinite. These
+     * will not continue to the next generation */
+    if(!tree.valid()) {
+        fitness = 0xDEADBEEF;
+        area = 0;
+        wirelength = 0;
+    } else {
+        area = tree.cost().area;
+        wirelength = tree.cost().wirelength;
+        fitness = FP_AREA_WEIGHT * area + FP_WIRE_WEIGHT * wirelength;
     }
-
-    return distLabel;
 }
 
 /********************************************************/
 /* Floorplan Citizen String Mutation implementation     */
 /********************************************************/
 
-void floorplan_citizen::mutate()
+void floorplan_citizen::mutate(std::minstd_rand& rng)
 {
-    int selection = rand() % 3;
+    int selection = rng() % 3;
     //selection = 2; //debug
 	
     switch(selection)
     {
 	case 0: {
-		/* Swap two operands; EG: 12HV45HV -> 12HV54HV
-		 * In this case, we swap two rows of the matrix to update it. */
-		auto swapped = swapOperands();
-		adjgraph[swapped.first].swap(adjgraph[swapped.second]);
+		/* Swap two operands; EG: 12HV45HV -> 12HV54HV */
+		auto swapped = swapOperands(rng);
+		evaluated = evaluated && tree.swapLeaves(polish, swapped.first, swapped.second);
 		}
 		break;
-	case 1: 
+	case 1: {
 		/* Find a chain of operators, and do: H->V, V->H */
-		complementChain();
-		generateAdjacencyGraph();
+		auto chain = complementChain(rng);
+		if(chain.first != -1)
+			evaluated = evaluated && tree.complementOperators(polish, chain.first, chain.second);
+		}
 		break;
-	case 2: 
+	case 2: {
 		/* Swap an adjacent operand (1,3,9)... with an adjacent H or V 
 		 * swapOperandOperator updates the operator counts. */
-		swapOperandOperator();
-		generateAdjacencyGraph();
+		auto swapped = swapOperandOperator(rng);
+		if(swapped.first != -1)
+			evaluated = evaluated && tree.swapOperandOperator(polish, swapped.first, swapped.second);
+		}
 		break;
     }
 }
 
-std::pair<int,int> floorplan_citizen::swapOperands()
+std::pair<int,int> floorplan_citizen::swapOperands(std::minstd_rand& rng)
 {
-	int operands[2];
 	int indicies[2];
 	
 	//Find two random indices in the polish that are not operators
@@ -157,83 +134,81 @@ std::pair<int,int> floorplan_citizen::swapOperands()
 	for(int i = 0; i != 2; ++i) {
 		int index = -1;
 		do {
-			index = rand() % polish.size();
-		} while(polish[index] == "H" || polish[index] == "V");
+			index = rng() % polish.size();
+		} while(isOperator(polish[index]));
 		indicies[i] = index;
-		operands[i] = std::atoi(polish[index].c_str());
 	}
 	
 	//Swap these indices in the polish
 	std::swap(polish.at(indicies[0]), polish.at(indicies[1]));
 	
-	//Return the elements swapped (not the indices)
-	return std::make_pair(operands[0], operands[1]);
+	//Return the indices swapped
+	return std::make_pair(indicies[0], indicies[1]);
 }
 
-std::pair<int,int> floorplan_citizen::complementChain()
+std::pair<int,int> floorplan_citizen::complementChain(std::minstd_rand& rng)
 {
-    std::vector<std::string>& str = polish;
+    std::vector<int>& str = polish;
     std::vector<int> chainIndex;
     
     for(unsigned i=1; i<str.size(); ++i)
     {
-        if( (str[i] == "H" || str[i] == "V") && (str[i-1] != "H" && str[i-1] != "V"))
+        if(isOperator(str[i]) && !isOperator(str[i-1]))
         {
             chainIndex.push_back(i);
         }
     }
     
-    int complementIndex = chainIndex[rand() % chainIndex.size()];
-    
-    //std::cout<<complementIndex<<"\n"; std::vector<std::string> stuff; //debug
+    if(chainIndex.empty())
+        return std::make_pair(-1, -1);
+    int complementIndex = chainIndex[rng() % chainIndex.size()];
     
-    for(unsigned i=complementIndex; (i<str.size() && (str[i] == "H" || str[i] == "V")); ++i)
+    unsigned i=complementIndex;
+    for(; (i<str.size() && isOperator(str[i])); ++i)
     {
-        if(str[i] == "H")
-        {
-            str[i] = "V";
-            //stuff.push_back(str[i]);
-        }
-        else if(str[i] == "V")
-        {
-            str[i] = "H";
-            //stuff.push_back(str[i]);
-        }
+        str[i] = (str[i] == H) ? V : H;
     }
     
-    //std::cout<<"changed: "; for(std::string st : stuff) { std::cout<<st<<" "; } std::cout<<"\n"; //debug
-    
-    return std::make_pair(complementIndex, -1);
+    //Return the range of operators complemented
+    return std::make_pair(complementIndex, int(i));
 }
 
-std::pair<int,int> floorplan_citizen::swapOperandOperator()
+std::pair<int,int> floorplan_citizen::swapOperandOperator(std::minstd_rand& rng)
 {
-    //std::vector<int> opCount = updateOpCount(str); //delete when done
-
-    int i = -1;
-
     //random left or right
-    int leftRight = rand() % 2;
+    int leftRight = rng() % 2;
 
     //if left then go to opposite side
     if(leftRight == 0) { leftRight = -1; }
 
-    bool done = false;
-    while(!done)
-    {
+    /* Operands next to an operator on side `leftRight` that can be swapped with it.
+     * Picking from the valid swaps, instead of retrying random indices until one is
+     * valid, means a polish with no valid swap on one side can not loop forever */
+    auto findSwaps = [this](int leftRight) {
+        std::vector<int> found;
         //1+ and -2 don't use the first/last string characters
-        i = 1 + rand() % (polish.size() - 2);
-
-        if(
-           ((polish[i-leftRight] != polish[i+leftRight])
-            || (2*opCounts[i] < i) )
-           && (polish[i] != "H" && polish[i] != "V")
-           && (polish[i+leftRight] == "H" || polish[i+leftRight] == "V")
-           )
-        {
-            done = true;
+        for(int i = 1; i + 1 < int(polish.size()); ++i) {
+            if(
+               ((polish[i-leftRight] != polish[i+leftRight])
+                || (2*opCounts[i] < i) )
+               && !isOperator(polish[i])
+               && isOperator(polish[i+leftRight])
+               )
+            {
+                found.push_back(i);
+            }
         }
+        return found;
+    };
+
+    std::vector<int> candidates = findSwaps(leftRight);
+    if(candidates.empty()) {
+        leftRight = -leftRight;
+        candidates = findSwaps(leftRight);
     }
+    if(candidates.empty())
+        return std::make_pair(-1, -1);
+    int i = candidates[rng() % candidates.size()];
 
     //Swap the operand and operator if we found a valid swap,
     //then update the operator counts
@@ -254,16 +229,44 @@ std::pair<int,int> floorplan_citizen::swapOperandOperator()
 /* Floorplan Adjacency graph implementation          */
 /******************************************************/
 
+const floorplan_citizen::adjword* floorplan_citizen::adjrow(char c, int g) const
+{
+    return &adjgraph[((c == 'H') ? g : adjsize + g) * adjwords];
+}
+
+char floorplan_citizen::adjacency(int g, int h) const
+{
+    adjword bit = adjword(1) << (h % 64);
+    if(adjrow('H', g)[h / 64] & bit)
+        return 'H';
+    if(adjrow('V', g)[h / 64] & bit)
+        return 'V';
+    return '-';
+}
+
+//Sets g->h to `c`, which is 'H', 'V' or '-' for no edge
+void floorplan_citizen::setAdjacency(int g, int h, char c)
+{
+    adjword bit = adjword(1) << (h % 64);
+    adjword& hWord = adjgraph[g * adjwords + h / 64];
+    adjword& vWord = adjgraph[(adjsize + g) * adjwords + h / 64];
+    hWord = (c == 'H') ? (hWord | bit) : (hWord & ~bit);
+    vWord = (c == 'V') ? (vWord | bit) : (vWord & ~bit);
+}
+
 /* Floorplan adjacency matrix validation:
  * An edge src->dst is valid if nothing attached to dst attaches to src
- * in the same way (eg, both Vs).
+ * in the same way (eg, both Vs). Edges are always set both ways, so this is
+ * whether the H rows or the V rows of src and dst share a bit, a word at a time.
  */
-bool floorplan_citizen::validateAddition(int src, int dst)
+bool floorplan_citizen::validateAddition(int src, int dst) const
 {
-    for(unsigned connection = 0; connection != adjgraph.size(); ++connection) {
-        if(adjgraph[src][connection] == '-')
-            continue;
-        if(adjgraph[src][connection] == adjgraph[connection][dst])
+    const adjword* srcH = adjrow('H', src);
+    const adjword* dstH = adjrow('H', dst);
+    const adjword* srcV = adjrow('V', src);
+    const adjword* dstV = adjrow('V', dst);
+    for(int w = 0; w != adjwords; ++w) {
+        if((srcH[w] & dstH[w]) | (srcV[w] & dstV[w]))
             return false;
     }
     return true;
@@ -277,14 +280,16 @@ void floorplan_citizen::generateAdjacencyGraph()
     std::stack<std::vector<int>>  stack;
 
     int nGates = gates->gates.size();
-    adjgraph.clear();
-    adjgraph.resize(nGates);
-    for(auto& row : adjgraph)
-        row.resize(nGates,'-');
+    adjgraphValid = true;
+    adjsize = nGates;
+    adjwords = (nGates + 63) / 64;
+    adjgraph.assign(2 * adjsize * adjwords, 0);
 
-    for(const std::string& c : this->polish)
+    for(int token : this->polish)
     {
-        if(c == "H" || c == "V") {
+        if(isOperator(token)) {
+            char c = (token == H) ? 'H' : 'V';
+
             /* We take XY[OP] off the stack, and connect all elements
              * in lhs to rhs. This usually isn't correct, so it
              * needs to be validated. The validation before all
@@ -301,8 +306,8 @@ void floorplan_citizen::generateAdjacencyGraph()
             for(int g : lhs) {
             for(int h : rhs) {
                 if(validateAddition(g,h)) {
-                    ((c == "H") ?  adjgraph[g][h] : adjgraph[h][g]) = c[0];
-                    ((c == "H") ?  adjgraph[h][g] : adjgraph[g][h]) = c[0];
+                    setAdjacency(g, h, c);
+                    setAdjacency(h, g, c);
                 }
             }
             }
@@ -315,7 +320,7 @@ void floorplan_citizen::generateAdjacencyGraph()
             stack.push(std::move(lhs));
         }
         else {
-            stack.push(std::vector<int>(1,std::atoi(c.c_str())));
+            stack.push(std::vector<int>(1,token));
         }
     }
 
@@ -325,12 +330,12 @@ void floorplan_citizen::generateAdjacencyGraph()
         adjgraphValid = false;
 
 #if 1
-    for(unsigned i = 0; i != adjgraph.size(); ++i)
-    for(unsigned j = 0; j != adjgraph.size(); ++j)
+    for(int i = 0; i != adjsize; ++i)
+    for(int j = 0; j != adjsize; ++j)
     {
         if(!validateAddition(i,j)) {
-            adjgraph[i][j] = '-';
-            adjgraph[j][i] = '-';
+            setAdjacency(i, j, '-');
+            setAdjacency(j, i, '-');
         }
     }
 #endif
@@ -338,19 +343,21 @@ void floorplan_citizen::generateAdjacencyGraph()
 
 std::string floorplan_citizen::getDotGraphText()
 {
+    generateAdjacencyGraph();
+
     std::stringstream ss;
     ss << "graph {" << std::endl;
 
-    for(unsigned i = 0; i != adjgraph.size(); ++i)
-    for(unsigned j = 0; j != adjgraph.size(); ++j)
+    for(int i = 0; i != adjsize; ++i)
+    for(int j = 0; j != adjsize; ++j)
     {
-        char c = adjgraph[i][j];
+        char c = adjacency(i, j);
         int weight = 0;
 
         if(c == 'H')
-            weight = gates->gates[i+2].length/2 + gates->gates[j+2].length/2;
+            weight = gates->lengths[i+2]/2 + gates->lengths[j+2]/2;
         else if(c == 'V')
-            weight = gates->gates[i+2].width/2  + gates->gates[j+2].width/2;
+            weight = gates->widths[i+2]/2  + gates->widths[j+2]/2;
 
         if(weight != 0)
             ss << '\t' << i << " -- " << j << " [label=\"  " << weight << "\"]" << std::endl;
@@ -2,7 +2,9 @@
 #define FLOORPLAN_CITIZEN_H
 #include <string>
 #include <vector>
+#include <random>
 #include "module.h"
+#include "slicing_tree.h"
 
 /* floorplan_citizen defines a Citizen type to be used
  * with a genetic algorithm */
@@ -13,53 +15,75 @@ public:
     //Citizen's fitness value
     long fitness = 0;
 
+    //Breakdown of the fitness from the last calc_fitness
+    long area = 0;
+    long wirelength = 0;
+
 public:
-    //Sets the gates to floorplan
-    void initialize(module* gates);
+    //Sets the gates to floorplan, and how wire length is measured
+    void initialize(module* gates, WireMetric metric = WireMetric::Connections);
 
-    //Returns the polish string of the citizen
+    //Returns the polish string of the citizen, as text
     std::vector<std::string> getPolish();
 
     //Return text for adjacency graph in DOT format
     std::string getDotGraphText();
 
-    /* The fitness of a floorplan is measured in total wire length.
-     * This is calculated as sum(i,j) cij * dij, where cij is the number
-     * of connections between gate i and j, and dij is the (approximate) distance. */
+    /* The fitness of a floorplan is its area plus its total wire length, both
+     * weighted. The polish is evaluated as a slicing tree, placing every gate, and
+     * the wire length is either sum(i,j) cij * dij, where cij is the number of
+     * connections between gate i and j and dij is the distance between their
+     * centers, or the half perimeter of each net's bounding box */
     void calc_fitness();
 
     /* Mutating a floorplan solution involves one of the three operations
-     *   on its polish representation:
+     *   on its polish representation, which the slicing tree follows in place:
      * 1) Swap two adjacent operands
      * 2) Complement an operator chain of non-zero length
-     * 3) Swap two adjacent operands and operators */
-    void mutate();
+     * 3) Swap two adjacent operands and operators
+     * All random choices are taken from `rng` */
+    void mutate(std::minstd_rand& rng);
 
 private:
     //Pointer to shared floorplan set of gates
     module* gates = nullptr;
 
-    //Polish representation of the plan
-    std::vector<std::string> polish;
+    /* Polish representation of the plan. Operands are gate numbers, and the
+     * operators are the negative tokens H and V, so copies are plain int copies */
+    enum : int { H = POLISH_H, V = POLISH_V };
+    std::vector<int> polish;
+
+    static bool isOperator(int token)
+    {
+        return token < 0;
+    }
 
 private:
     //Mutation functions and types
     //Components: Roger polish string manipulations
-    std::pair<int,int> swapOperands();
-    std::pair<int,int> complementChain();
-    std::pair<int,int> swapOperandOperator();
+    std::pair<int,int> swapOperands(std::minstd_rand& rng);
+    std::pair<int,int> complementChain(std::minstd_rand& rng);
+    std::pair<int,int> swapOperandOperator(std::minstd_rand& rng);
 	std::vector<int> opCounts;
 
-    //Fitness evaluation functions and types
-    //Components: Dijkstra's on the adjgraph, and summation
-    std::vector<int> shortestPaths(int start);
-    int gateDistance(int,int,char);
+    /* Fitness evaluation: the slicing tree of the polish, and how wires are measured.
+     * Once evaluated, mutations update the tree instead of evaluating it again */
+    SlicingTree tree;
+    WireMetric metric = WireMetric::Connections;
+    bool evaluated = false;
 
-    //Adjacency graph types and functions
-    typedef std::vector<std::vector<char>> floorplan_adjgraph;
-    bool validateAddition(int src, int dst);
+    /* Adjacency graph types and functions, only built for getDotGraphText. The H and
+     * V neighbors of the gates are two bit matrices in one allocation: row g of
+     * matrix H is adjgraph[g*adjwords, (g+1)*adjwords), and matrix V follows */
+    typedef unsigned long long adjword;
+    bool validateAddition(int src, int dst) const;
     void generateAdjacencyGraph();
-    floorplan_adjgraph adjgraph;
+    char adjacency(int g, int h) const;
+    void setAdjacency(int g, int h, char c);
+    const adjword* adjrow(char c, int g) const;
+    std::vector<adjword> adjgraph;
+    int adjsize = 0;
+    int adjwords = 0;
     bool adjgraphValid = true;
 };
 
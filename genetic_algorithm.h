@@ -11,7 +11,9 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <random>
 #include <math.h>
+#include "threadpool.h"
 
 //Default genetic algorithm tuning parameters
 #define GA_POPSIZE_DEF      2048    //Population size
@@ -31,9 +33,23 @@ public:
 
     Citizen go();   //Runs the algorithm until a Citizen has 0 fitness
 
+    /* Splits each generation's fitness evaluation, and the mating and mutation of its
+     * children, over up to `threads` tasks of the shared thread pool. Citizens must
+     * then be evaluated, mated and mutated independently of each other */
+    void setFitnessThreads(unsigned threads);
+
 protected:
     typedef std::vector<Citizen> population;
 
+    /* Random numbers for mate and mutate. Each child has its own engine, seeded from
+     * rand() before the children are handed out, so a run does not depend on threads */
+    typedef std::minstd_rand random_engine;
+
+    /* Calls `fitness` on every citizen of `pop`, split over the fitness threads.
+     * For use by calc_fitness */
+    template<typename F>
+    void for_each_citizen(population& pop, F fitness);
+
     //init_population: Initilize a population
     //calc_fitness:    Update fitness values of the entire population
     //mate:            Form a new child citizen out of two parent citizens
@@ -41,10 +57,13 @@ protected:
 
     virtual void init_population(population& pop) = 0;
     virtual void calc_fitness(population& pop) = 0;
-    virtual void mate(Citizen& child, const Citizen& mom, const Citizen& dad) = 0;
-    virtual void mutate(Citizen& member) = 0;
+    virtual void mate(Citizen& child, const Citizen& mom, const Citizen& dad, random_engine& rng) = 0;
+    virtual void mutate(Citizen& member, random_engine& rng) = 0;
 
 private:
+    template<typename F>
+    void for_each_citizen(Citizen* first, Citizen* last, F fitness);
+
     void mate_populations(); //Creates the next generation
     void swap_populations(); //Makes the next generation (beta) the new generation (alpha)
     void sort_by_fitness();  //Sorts current generation by fitness
@@ -52,11 +71,16 @@ private:
 private:
     int GA_POPSIZE;          // population size
     int GA_MAXITER;          // maximum iterations (generations)
-    int GA_MUTATE_THRESH;    // rand() upper threshold for mutation
+    unsigned long GA_MUTATE_THRESH; // random_engine upper threshold for mutation
     int GA_ESIZE;            // number of citizens to move to next generation
+    unsigned GA_THREADS;     // tasks each generation is split over
 
     population pop_alpha;    //The current generation
     population pop_beta;     //The next generation
+
+    //Parents and random seed of each child of the next generation
+    struct mating { int mom, dad; unsigned seed; };
+    std::vector<mating> matings;
 };
 
 /*************************************************************/
@@ -65,25 +89,74 @@ template<typename Citizen>
 GeneticAlgorithm<Citizen>::GeneticAlgorithm(int popSize, int maxIter, float eliteRate, float mutateRate)
     : GA_POPSIZE(popSize)
     , GA_MAXITER(maxIter)
-    , GA_MUTATE_THRESH(RAND_MAX * mutateRate)
+    , GA_MUTATE_THRESH(random_engine::max() * mutateRate)
     , GA_ESIZE(GA_POPSIZE * eliteRate)
+    , GA_THREADS(1)
     { }
 
 template<typename Citizen>
-void GeneticAlgorithm<Citizen>::mate_populations()
+void GeneticAlgorithm<Citizen>::setFitnessThreads(unsigned threads)
 {
-    //Elitism: The strongest survive to next generation (pop_alpha -> pop_beta)
-    std::move(pop_alpha.begin(), pop_alpha.begin() + (GA_POPSIZE/2), pop_beta.begin());
+    GA_THREADS = std::max(1u, threads);
+}
+
+template<typename Citizen>
+template<typename F>
+void GeneticAlgorithm<Citizen>::for_each_citizen(population& pop, F fitness)
+{
+    for_each_citizen(pop.data(), pop.data() + pop.size(), fitness);
+}
 
-    // Mate the rest (pop_alpha X pop_alpha -> pop_beta)
+template<typename Citizen>
+template<typename F>
+void GeneticAlgorithm<Citizen>::for_each_citizen(Citizen* first, Citizen* last, F fitness)
+{
+    unsigned size = last - first;
+    unsigned tasks = std::min<unsigned>(GA_THREADS, size);
+    if(tasks <= 1) {
+        for(Citizen* citizen = first; citizen != last; ++citizen)
+            fitness(*citizen);
+        return;
+    }
+
+    //Each task takes an even run of the citizens
+    TaskGroup group;
+    for(unsigned t = 0; t != tasks; ++t) {
+        Citizen* begin = first + size * t / tasks;
+        Citizen* end   = first + size * (t + 1) / tasks;
+        group.run([begin, end, &fitness]() {
+            for(Citizen* citizen = begin; citizen != end; ++citizen)
+                fitness(*citizen);
+        });
+    }
+    group.wait();
+}
+
+template<typename Citizen>
+void GeneticAlgorithm<Citizen>::mate_populations()
+{
+    //Parents come from the stronger half of this generation
+    matings.resize(GA_POPSIZE);
     for (int i=GA_ESIZE; i<GA_POPSIZE; ++i)
     {
-        int i1 = rand() % (GA_POPSIZE / 2);
-        int i2 = rand() % (GA_POPSIZE / 2);
-        mate(pop_beta[i], pop_beta[i1], pop_beta[i2]);
-        if(rand() < GA_MUTATE_THRESH)
-            mutate(pop_beta[i]);
+        matings[i].mom  = rand() % (GA_POPSIZE / 2);
+        matings[i].dad  = rand() % (GA_POPSIZE / 2);
+        matings[i].seed = rand();
     }
+
+    /* Mate the rest (pop_alpha X pop_alpha -> pop_beta). Children only read their
+     * parents in pop_alpha, so each is copied and mutated in a task of its own */
+    Citizen* children = pop_beta.data();
+    for_each_citizen(children + GA_ESIZE, children + GA_POPSIZE, [this, children](Citizen& child) {
+        const mating& m = matings[&child - children];
+        random_engine rng(m.seed);
+        mate(child, pop_alpha[m.mom], pop_alpha[m.dad], rng);
+        if(rng() < GA_MUTATE_THRESH)
+            mutate(child, rng);
+    });
+
+    //Elitism: The strongest survive to next generation (pop_alpha -> pop_beta)
+    std::move(pop_alpha.begin(), pop_alpha.begin() + GA_ESIZE, pop_beta.begin());
 }
 
 template<typename Citizen>
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <utility>
+#include <unordered_map>
+#include "hypergraph.h"
+
+int hypergraph::numNets() const
+{
+    return netStart.size() - 1;
+}
+
+int hypergraph::numGates() const
+{
+    return gateStart.size() - 1;
+}
+
+/* Builds a hypergraph from (net, gate) pin pairs. Repeated pins are merged and
+ * nets with fewer than two gates are dropped. `pinPairs` is sorted in the process */
+static hypergraph fromPins(int nGates, std::vector<std::pair<int,int>>& pinPairs)
+{
+    hypergraph h;
+    std::sort(pinPairs.begin(), pinPairs.end());
+    pinPairs.erase(std::unique(pinPairs.begin(), pinPairs.end()), pinPairs.end());
+
+    //Each run of equal nets is one hyperedge
+    for(size_t first = 0, last = 0; first != pinPairs.size(); first = last) {
+        while(last != pinPairs.size() && pinPairs[last].first == pinPairs[first].first)
+            ++last;
+        if(last - first < 2)
+            continue;
+        for(size_t i = first; i != last; ++i)
+            h.pins.push_back(pinPairs[i].second);
+        h.netStart.push_back(h.pins.size());
+    }
+
+    //Transpose the pin lists into the nets of each gate
+    h.gateStart.assign(nGates + 1, 0);
+    for(int g : h.pins)
+        h.gateStart[g+1] += 1;
+    for(int g = 0; g != nGates; ++g)
+        h.gateStart[g+1] += h.gateStart[g];
+    h.gateNets.resize(h.pins.size());
+    std::vector<int> fill(h.gateStart.begin(), h.gateStart.end() - 1);
+    for(int e = 0; e != h.numNets(); ++e)
+        for(int p = h.netStart[e]; p != h.netStart[e+1]; ++p)
+            h.gateNets[fill[h.pins[p]]++] = e;
+
+    return h;
+}
+
+hypergraph buildHypergraph(const std::vector<gate_instance>& gates)
+{
+    /* Nets are numbered in the order the gates first use them, not by net ID, so the
+     * hyperedges do not depend on the order names were interned in */
+    std::unordered_map<netid, int> number;
+    auto numberOf = [&number](netid n) {
+        return number.emplace(n, int(number.size())).first->second;
+    };
+
+    std::vector<std::pair<int,int>> pinPairs;
+    for(unsigned g = 0; g != gates.size(); ++g) {
+        for(netid n : gates[g].inputs)
+            pinPairs.emplace_back(numberOf(n), g);
+        for(netid n : gates[g].outputs)
+            pinPairs.emplace_back(numberOf(n), g);
+    }
+    return fromPins(gates.size(), pinPairs);
+}
+
+hypergraph subHypergraph(const hypergraph& src, const std::vector<int>& keep)
+{
+    //Map from gates in `src` to gates in the result, or -1 if not kept
+    std::vector<int> newIndex(src.numGates(), -1);
+    for(unsigned i = 0; i != keep.size(); ++i)
+        newIndex[keep[i]] = i;
+
+    std::vector<std::pair<int,int>> pinPairs;
+    for(int e = 0; e != src.numNets(); ++e) {
+        for(int p = src.netStart[e]; p != src.netStart[e+1]; ++p) {
+            int g = newIndex[src.pins[p]];
+            if(g != -1)
+                pinPairs.emplace_back(e, g);
+        }
+    }
+    return fromPins(keep.size(), pinPairs);
+}
+
+hypergraph contractHypergraph(const hypergraph& src, const std::vector<int>& merged, int size)
+{
+    std::vector<std::pair<int,int>> pinPairs;
+    pinPairs.reserve(src.pins.size());
+    for(int e = 0; e != src.numNets(); ++e)
+        for(int p = src.netStart[e]; p != src.netStart[e+1]; ++p)
+            pinPairs.emplace_back(e, merged[src.pins[p]]);
+    return fromPins(size, pinPairs);
+}
@@ -0,0 +1,34 @@
+#ifndef HYPERGRAPH_H
+#define HYPERGRAPH_H
+#include <vector>
+#include "stdcell.h"
+
+/* Hypergraph of a module's nets. Each net is a hyperedge holding the list
+ * of gates it connects, so a net with fanout F takes O(F) space instead of
+ * the O(F^2) entries of a clique in the connectivity matrix.
+ * The pins of net e are pins[netStart[e], netStart[e+1]), and the nets of
+ * gate g are gateNets[gateStart[g], gateStart[g+1]) */
+
+struct hypergraph
+{
+    std::vector<int> netStart = std::vector<int>(1, 0);
+    std::vector<int> pins;
+    std::vector<int> gateStart = std::vector<int>(1, 0);
+    std::vector<int> gateNets;
+
+    int numNets() const;
+    int numGates() const;
+};
+
+//Builds the hypergraph of all nets connecting two or more of `gates`
+hypergraph buildHypergraph(const std::vector<gate_instance>& gates);
+
+/* Builds the hypergraph between only the gates in `keep`, where gate keep[i] of
+ * `src` becomes gate i of the result. Nets left with fewer than two pins are dropped */
+hypergraph subHypergraph(const hypergraph& src, const std::vector<int>& keep);
+
+/* Builds a `size` gate hypergraph where gate i of `src` is merged into gate
+ * merged[i]. Nets left with fewer than two pins are dropped */
+hypergraph contractHypergraph(const hypergraph& src, const std::vector<int>& merged, int size);
+
+#endif
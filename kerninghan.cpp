@@ -1,110 +1,243 @@
 #include <algorithm>
+#include <numeric>
+#include <cmath>
 #include <tuple>
 #include <iostream>
-#include <set>
 #include <thread>
-#include <future>
+#include <memory>
 #include <ciso646>
+#include <limits>
+#include <random>
+#include <mutex>
+#include <atomic>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KL_AVX2_KERNEL                  //Build the AVX2 gain kernel, picked at run time when the CPU has it
+#include <immintrin.h>
+#endif
 #include "utility.h"
 #include "kerninghan.h"
+#include "fiduccia.h"
+#include "multilevel.h"
+#include "kway.h"
+#include "threadpool.h"
 
 //Type definitions used in this file
 typedef unsigned int gate;
 typedef std::vector<int>  vint;
-typedef std::vector<vint> vvint;
-typedef std::set<gate>    partition;
 typedef std::tuple<gate,gate,int> swappair;
 
+#define KL_PARALLEL_MIN_GATES   2048    //Smallest A' searched for swap pairs on several threads
+
+//Best swap pair found so far. A pair must gain more than -99 to be taken at all
+struct bestpair
+{
+    gate i = 0;
+    gate j = 0;
+    int  gain = -99;
+    bool found = false;
+
+    //Whether pair (i,j) with `gain` replaces this one: a higher gain, or the first pair in gate order on ties
+    bool better(int gain, gate i, gate j) const
+    {
+        return gain > this->gain || (gain == this->gain && found && std::make_pair(i,j) < std::make_pair(this->i,this->j));
+    }
+
+    //Whether no pair with a gain of at most `bound` can replace this one
+    bool beaten(int bound) const
+    {
+        return bound < gain || (bound == gain && !found);
+    }
+};
+
+#ifdef KL_AVX2_KERNEL
+//maxSwapGain's first `count` rounded down to 8 gates, eight at a time. Returns INT_MIN for none
+__attribute__((target("avx2")))
+static int maxSwapGainAVX2(int di, const int* dj, const int* weights, int count)
+{
+    __m256i vdi   = _mm256_set1_epi32(di);
+    __m256i vbest = _mm256_set1_epi32(std::numeric_limits<int>::min());
+    for(int k = 0; k + 8 <= count; k += 8) {
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dj + k));
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + k));
+        vbest = _mm256_max_epi32(vbest, _mm256_sub_epi32(_mm256_add_epi32(vdi, d), _mm256_slli_epi32(w, 1)));
+    }
+    alignas(32) int lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), vbest);
+    return *std::max_element(lanes, lanes + 8);
+}
+
+//Checked while static objects are built, which may be before the CPU model is filled in
+static bool detectAVX2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+static const bool hasAVX2 = detectAVX2();
+#endif
+
+/* Highest D[i] + D[j] - 2*c[i][j] over the first `count` gates j of B', given their D
+ * values in `dj` and connections to i in `weights`. Eight gates at a time when the
+ * CPU has AVX2 */
+static int maxSwapGain(int di, const int* dj, const int* weights, int count)
+{
+    int best = std::numeric_limits<int>::min();
+    int k = 0;
+#ifdef KL_AVX2_KERNEL
+    if(hasAVX2 && count >= 8) {
+        best = maxSwapGainAVX2(di, dj, weights, count);
+        k = count - count % 8;
+    }
+#endif
+    for(; k < count; ++k)
+        best = std::max(best, di + dj[k] - 2*weights[k]);
+    return best;
+}
+
 class KernighanLinSolver
 {
 public:
-    KernighanLinSolver(const vvint& matrix)
+    KernighanLinSolver(const connectivity& matrix, unsigned threads, unsigned seed = 0, const vint& pull = vint())
+        : threads(std::max(1u, threads)), pull(pull)
     {
-        initPartitions(matrix);
+        initPartitions(matrix.size(), seed);
         initConnections(matrix);
         solve(matrix);
     }
+
+    //Partitions on the hypergraph of nets, measuring cut size on the hyperedges
+    KernighanLinSolver(const hypergraph& nets, unsigned seed = 0, const vint& pull = vint()) : pull(pull)
+    {
+        initPartitions(nets.numGates(), seed);
+        swapped.resize(nets.numGates(), 0);
+        d_values.resize(nets.numGates());
+        solveHypergraph(nets);
+    }
     
     operator std::pair<vint,vint>() 
     {
         vint va, vb;
-        for(gate g : a) 
-            va.push_back(g);
-        for(gate g : b) 
-            vb.push_back(g);
+        for(gate g = 0; g != part.size(); ++g)
+            (part[g] == 0 ? va : vb).push_back(g);
         return std::move(std::make_pair(std::move(va), std::move(vb)));
     }
+
+    //0 for each gate in partition A, 1 for each in B
+    const vint& sides() const
+    {
+        return part;
+    }
     
 private:
-    partition a;    //Partition A
-    partition b;    //Partition B
-    partition ap;   //Partition A'
-    partition bp;   //Partition B'
+    vint  part;     //0 if a gate is in partition A, 1 if in B
+    vint  unlocked; //1 while a gate is still in A' or B' during a pass
     vint  external; //Vector of # external wires for each gate
     vint  internal; //Vector of # internal wires for each gate
     vint  swapped;  //WHo's been swapped?
     vint  d_values; //Calculated D values (external[g] - internal[g])
-    vvint gains;    //gain values matrix
+
+    //Wire counts of the current partitions. Passes work on copies in `external`/`internal`
+    vint  settledExternal;
+    vint  settledInternal;
+
+    //Unswapped gates of A' and B' by decreasing D value, for pruning the best pair search
+    std::vector<std::pair<int,gate>> candidates[2];
+    vint  candidateD; //D values of candidates[1]
+    vint  position;   //Index of each gate in candidates[1], or -1
+
+    //Dense connections of an A' gate to B' for each search task, left all 0 between rows
+    std::vector<vint> rowScratch;
+    unsigned threads; //Threads the best pair search may use
+
+    //Pull of fixed terminals on each gate, towards B if positive and A if negative
+    vint  pull;
+
+    //Hypergraph partitioning state
+    vint  side;          //0 if a gate is on the A side of the current pass, 1 if B
+    vint  pinsOnSide[2]; //Number of pins each net has on the A and B sides
     
 private:
-    void initPartitions(const vvint& matrix)
+    /* Seed 0 starts from the first half of the gates in A and the rest in B. Any
+     * other seed starts from a random half, the same one every time for that seed */
+    void initPartitions(int n, unsigned seed)
     {
-        //We start with a random partition of the gates'
-        int n2 = matrix.size() / 2;
-        int n  = matrix.size();
-        for(int i = 0; i != n2; ++i)
-            a.insert(i);
-        for(int i = n2; i != n; ++i)
-            b.insert(i);
+        int n2 = n / 2;
+        part.assign(n, 1);
+        if(seed == 0) {
+            std::fill(part.begin(), part.begin() + n2, 0);
+        } else {
+            vint order(n);
+            std::iota(order.begin(), order.end(), 0);
+            std::shuffle(order.begin(), order.end(), std::minstd_rand(seed));
+            for(int k = 0; k != n2; ++k)
+                part[order[k]] = 0;
+        }
+        unlocked.assign(n, 0);
     }
 
-    void initConnections(const vvint& matrix)
+    void initConnections(const connectivity& matrix)
     {
         //Initializing and filling internal and external connections
         int numGates = matrix.size();
-        external.resize(numGates, 0);
-        internal.resize(numGates, 0);
+        settledExternal.resize(numGates, 0);
+        settledInternal.resize(numGates, 0);
         swapped.resize(numGates, 0);
         recalculateWireCosts(matrix);
         
-        //Initializing D and gain values connections
+        //Initializing D values connections
         d_values.resize(numGates);
-        gains.resize(numGates);
-        for(vint& row : gains) row.resize(numGates);
-
-        //Fill in D values for partition a and b, and gain matrix
-        recomputeDValues(matrix);
-        recalculateGains(matrix);
+        position.assign(numGates, -1);
     }
     
-    void recalculateWireCosts(const vvint& matrix)
+    void recalculateWireCosts(const connectivity& matrix)
     {
-        std::fill(internal.begin(), internal.end(), 0);
-        std::fill(external.begin(), external.end(), 0);
+        std::fill(settledInternal.begin(), settledInternal.end(), 0);
+        std::fill(settledExternal.begin(), settledExternal.end(), 0);
         unsigned numGates = matrix.size();
         for(gate g = 0; g != numGates; ++g) 
         {
-            const partition& mine = (a.find(g) != a.end()) ? a : b;
-            const vint& row = matrix[g];
-            for(gate connection = 0; connection != row.size(); ++connection) {
-                if((!row[connection]) || (g == connection))
+            for(int e = matrix.rowStart[g]; e != matrix.rowStart[g+1]; ++e) {
+                gate connection = matrix.columns[e];
+                if(g == connection)
                     continue;
-                if(mine.find(connection) != mine.end()) {
-                    internal[g] += 1;
+                if(part[connection] == part[g]) {
+                    settledInternal[g] += 1;
                 } else {
-                    external[g] += 1;
+                    settledExternal[g] += 1;
                 }
             }
         }
+
+        //Terminals count as wires to a gate that never moves, so swaps flip them too
+        for(gate g = 0; g != pull.size(); ++g) {
+            bool towardsOwn = (pull[g] > 0) == (part[g] == 1);
+            (towardsOwn ? settledInternal[g] : settledExternal[g]) += std::abs(pull[g]);
+        }
+    }
+
+    /* Moves gate `g` to the other partition, keeping the settled wire counts of it and
+     * its neighbours exact. Only gates connected to `g` change, so a pass's swaps cost
+     * their degree instead of recounting every wire */
+    void moveSettled(gate g, const connectivity& matrix)
+    {
+        for(int e = matrix.rowStart[g]; e != matrix.rowStart[g+1]; ++e) {
+            gate x = matrix.columns[e];
+            if(x == g)
+                continue;
+            bool wasInternal = part[x] == part[g];
+            (wasInternal ? settledInternal[x] : settledExternal[x]) -= 1;
+            (wasInternal ? settledExternal[x] : settledInternal[x]) += 1;
+        }
+        std::swap(settledInternal[g], settledExternal[g]);
+        part[g] = 1 - part[g];
     }
     
-    void recomputeDValues(const vvint& matrix)
+    //Starts a pass from the settled wire counts
+    void recomputeDValues()
     {
-        recalculateWireCosts(matrix);
-        for(gate g : a)
-            d_values[g] = getDValue(g);        
-        for(gate g : b)
-            d_values[g] = getDValue(g);    
+        internal = settledInternal;
+        external = settledExternal;
+        for(gate g = 0; g != part.size(); ++g)
+            d_values[g] = getDValue(g);
     }
 
     int getDValue(gate which)
@@ -112,27 +245,88 @@ private:
         return external[which] - internal[which];
     }
 
-    int getSwapGain(gate a, gate b, const vvint& matrix)
+    /* Finds the highest gain pair of unswapped gates in A' x B', taking the first pair
+     * in gate order on ties. Gains are at most D[i] + D[j], so with both sides sorted
+     * by D only the B' gates whose bound can still beat the best pair are searched */
+    swappair getBestSwapPair(const connectivity& matrix)
     {
-        return getDValue(a) + getDValue(b) - 2*matrix[a][b];
+        for(int s = 0; s != 2; ++s) {
+            candidates[s].clear();
+            for(gate g = 0; g != part.size(); ++g)
+                if(part[g] == s && unlocked[g] && not(swapped[g]))
+                    candidates[s].emplace_back(-d_values[g], g);
+            std::sort(candidates[s].begin(), candidates[s].end());
+        }
+
+        //Lay B' out as contiguous D values for the gain kernel
+        candidateD.resize(candidates[1].size());
+        for(unsigned k = 0; k != candidates[1].size(); ++k) {
+            candidateD[k] = -candidates[1][k].first;
+            position[candidates[1][k].second] = k;
+        }
+
+        /* Each task searches every nThreads'th gate of A', then the best pairs are reduced.
+         * Tasks run on the shared pool, with the first on this thread */
+        unsigned nThreads = candidates[0].size() >= KL_PARALLEL_MIN_GATES ? threads : 1;
+        std::vector<bestpair> best(nThreads);
+        rowScratch.resize(std::max<size_t>(rowScratch.size(), nThreads));
+        auto search = [&](unsigned t) {
+            rowScratch[t].resize(candidates[1].size(), 0);
+            for(unsigned k = t; k < candidates[0].size(); k += nThreads)
+                if(!searchRow(candidates[0][k].second, matrix, rowScratch[t], best[t]))
+                    break;
+        };
+        if(nThreads > 1) {
+            TaskGroup group;
+            for(unsigned t = 1; t != nThreads; ++t)
+                group.run([&search, t]() { search(t); });
+            search(0);
+            group.wait();
+        } else {
+            search(0);
+        }
+
+        for(const bestpair& p : best)
+            if(p.found && best[0].better(p.gain, p.i, p.j))
+                best[0] = p;
+        for(const auto& c : candidates[1])
+            position[c.second] = -1;
+        return swappair(best[0].i, best[0].j, best[0].gain);
     }
-    
-    swappair getBestSwapPair(const vvint& matrix)
+
+    /* Best pair of A' gate `i` with B', found by scattering the row of `i` into the
+     * dense `rowWeights` of B' and running the gain kernel over it. Returns false when
+     * no B' gate can beat `best`, which then holds for every later gate of A' too */
+    bool searchRow(gate i, const connectivity& matrix, std::vector<int>& rowWeights, bestpair& best)
     {
-        gate max_i = 0, max_j = 0;
-        int  max_value = -99;
-
-        for(gate i : ap) 
-        for(gate j : bp) {
-            int gain = getSwapGain(i,j,matrix);
-            if(gain > max_value && not(swapped[i]) && not(swapped[j])) {
-                max_i = i;
-                max_j = j;
-                max_value = gain;
+        int di = d_values[i];
+        int count = std::partition_point(candidateD.begin(), candidateD.end(),
+            [&](int dj) { return !best.beaten(di + dj); }) - candidateD.begin();
+        if(count == 0)
+            return false;
+
+        for(int e = matrix.rowStart[i]; e != matrix.rowStart[i+1]; ++e)
+            if(position[matrix.columns[e]] != -1)
+                rowWeights[position[matrix.columns[e]]] = matrix.weights[e];
+        int gain = maxSwapGain(di, candidateD.data(), rowWeights.data(), count);
+
+        //Ties are broken on the lowest gate, so look for it among the best gains
+        if(gain > best.gain || (gain == best.gain && best.found)) {
+            for(int k = 0; k != count; ++k) {
+                gate j = candidates[1][k].second;
+                if(di + candidateD[k] - 2*rowWeights[k] == gain && best.better(gain, i, j)) {
+                    best.i = i;
+                    best.j = j;
+                    best.gain = gain;
+                    best.found = true;
+                }
             }
         }
 
-        return swappair(max_i, max_j, max_value);
+        for(int e = matrix.rowStart[i]; e != matrix.rowStart[i+1]; ++e)
+            if(position[matrix.columns[e]] != -1)
+                rowWeights[position[matrix.columns[e]]] = 0;
+        return true;
     }
     
     std::pair<int,int> getBestPartialSumKG(std::vector<swappair>& swapPair)
@@ -154,43 +348,148 @@ private:
         return {k_best, g_best};
     }
     
-    void recalculateGains(const vvint& matrix)
+    void recalculateDValues(gate rm_a, gate rm_b, const connectivity& matrix)
     {
-        for(auto& row : gains)
-            std::fill(row.begin(), row.end(), 0);
-        for(gate g : a) 
-            for(gate h : b) {
-                gains[g][h] = getSwapGain(g, h, matrix);
-                gains[h][g] = getSwapGain(h, g, matrix);    
+        int rm_a_p = part[rm_a];
+        int rm_b_p = part[rm_a];
+
+        //Only gates still in A' or B' that connect to the removed gate change
+        auto updateNeighbors = [&](gate removed, int removed_p) {
+            for(int e = matrix.rowStart[removed]; e != matrix.rowStart[removed+1]; ++e) {
+                gate x = matrix.columns[e];
+                if(not(unlocked[x]))
+                    continue;
+                ((part[x] == removed_p) ? internal[x] : external[x]) -= matrix.weights[e];
+                d_values[x] = getDValue(x);
             }
+        };
+
+        updateNeighbors(rm_a, rm_a_p);
+        updateNeighbors(rm_b, rm_b_p);
     }
     
-    void recalculateDValues(gate rm_a, gate rm_b, const vvint& matrix)
+    /* Hypergraph D value contribution of net e to gate g: moving g to the other side
+     * uncuts e if g is its last pin on this side, and cuts e if e was all on this side */
+    int getNetGain(gate g, int e)
+    {
+        int from = pinsOnSide[side[g]][e];
+        int to   = pinsOnSide[1 - side[g]][e];
+        return (to > 0) - (from > 1);
+    }
+
+    //Sets sides and net pin counts from partitions a and b, and all D values from them
+    void recountNets(const hypergraph& nets)
     {
-        //recalculateWireCosts(matrix);
-        partition& rm_a_p = (a.find(rm_a) != a.end()) ? a : b;
-        partition& rm_b_p = (a.find(rm_a) != a.end()) ? a : b;
+        side = part;
+        for(int s = 0; s != 2; ++s)
+            pinsOnSide[s].assign(nets.numNets(), 0);
+        for(gate g = 0; g != side.size(); ++g)
+            for(int i = nets.gateStart[g]; i != nets.gateStart[g+1]; ++i)
+                pinsOnSide[side[g]][nets.gateNets[i]] += 1;
 
-        for(gate x : ap) {
-            if(!(matrix[x][rm_a] or matrix[x][rm_b]))
-                continue;
-            partition& mine = a.find(x) != a.end() ? a : b;
-            ((&mine == &rm_a_p) ? internal[x] : external[x]) -= matrix[x][rm_a];
-            ((&mine == &rm_b_p) ? internal[x] : external[x]) -= matrix[x][rm_b];
-            d_values[x] = getDValue(x);
+        for(gate g = 0; g != side.size(); ++g) {
+            d_values[g] = pull.empty() ? 0 : (side[g] == 0 ? pull[g] : -pull[g]);
+            for(int i = nets.gateStart[g]; i != nets.gateStart[g+1]; ++i)
+                d_values[g] += getNetGain(g, nets.gateNets[i]);
         }
-        for(gate x : bp) {
-            if(!(matrix[x][rm_a] or matrix[x][rm_b]))
-                continue;
-            partition& mine = a.find(x) != a.end() ? a : b;
-            ((&mine == &rm_a_p) ? internal[x] : external[x]) -= matrix[x][rm_a];
-            ((&mine == &rm_b_p) ? internal[x] : external[x]) -= matrix[x][rm_b];
-            d_values[x] = getDValue(x);
+    }
+
+    /* Moves gate `moved` to the other side, updating net pin counts and the D values
+     * of gates on its nets. A net's gains only change when its pin count on either
+     * side is near zero, so large nets away from that are O(1) to update */
+    void moveGate(gate moved, const hypergraph& nets)
+    {
+        int from = side[moved], to = 1 - from;
+        for(int i = nets.gateStart[moved]; i != nets.gateStart[moved+1]; ++i) {
+            int e = nets.gateNets[i];
+            bool gainsChange = pinsOnSide[to][e] <= 1 || pinsOnSide[from][e] <= 2;
+            if(gainsChange)
+                for(int p = nets.netStart[e]; p != nets.netStart[e+1]; ++p)
+                    if(gate(nets.pins[p]) != moved)
+                        d_values[nets.pins[p]] -= getNetGain(nets.pins[p], e);
+            pinsOnSide[from][e] -= 1;
+            pinsOnSide[to][e]   += 1;
+            if(gainsChange)
+                for(int p = nets.netStart[e]; p != nets.netStart[e+1]; ++p)
+                    if(gate(nets.pins[p]) != moved)
+                        d_values[nets.pins[p]] += getNetGain(nets.pins[p], e);
+        }
+        side[moved] = to;
+    }
+
+    //Gate of A' (s = 0) or B' (s = 1) with the highest D value that has not been swapped, or `none`
+    gate getBestMove(int s, gate none)
+    {
+        gate best = none;
+        for(gate g = 0; g != part.size(); ++g)
+            if(part[g] == s && unlocked[g] && not(swapped[g]) && (best == none || d_values[g] > d_values[best]))
+                best = g;
+        return best;
+    }
+
+    //Swaps the gates of the best prefix of `swapPairs` between A and B, if it gains anything
+    template<class MoveGate>
+    bool applyBestPrefix(std::vector<swappair>& swapPairs, MoveGate move)
+    {
+        auto kg_pair = getBestPartialSumKG(swapPairs);
+        int k_max = kg_pair.first;
+        int g_max = kg_pair.second;
+        if(g_max <= 0)
+            return false;
+        for(int i = 0; i != k_max+1; ++i) {
+            gate swap_a = std::get<0>(swapPairs[i]);
+            gate swap_b = std::get<1>(swapPairs[i]);    
+            swapped[swap_a] = 1;
+            swapped[swap_b] = 1;
+            move(swap_a);
+            move(swap_b);
+        }
+        return true;
+    }
+
+    /* KL passes on the hypergraph. The best pair is found by moving the best gate
+     * of A' and then the best gate of B' given that move, so the recorded gain of
+     * each pair is the exact change in the number of cut nets */
+    void solveHypergraph(const hypergraph& nets)
+    {
+        const gate none = nets.numGates();
+        while(1)
+        {
+            //"Queue" of maximum gain pairs; stores av, bv, and gv
+            std::vector<swappair> swapPairs;
+            
+            //Initializes A' and B' to the full partitions
+            std::fill(unlocked.begin(), unlocked.end(), 1);
+            recountNets(nets);
+            
+            for(int i = 1; i < nets.numGates()/2; ++i)
+            {
+                gate rm_a = getBestMove(0, none);
+                if(rm_a == none)
+                    break;
+                int gain = d_values[rm_a];
+                unlocked[rm_a] = 0;
+                moveGate(rm_a, nets);
+
+                gate rm_b = getBestMove(1, none);
+                if(rm_b == none)
+                    break;
+                gain += d_values[rm_b];
+                unlocked[rm_b] = 0;
+                moveGate(rm_b, nets);
+
+                swapPairs.emplace_back(rm_a, rm_b, gain);
+            }
+            if(swapPairs.empty())
+                break;
+
+            //Swap the best prefix of pairs in a and b, as in `solve`
+            if(!applyBestPrefix(swapPairs, [this](gate g) { part[g] = 1 - part[g]; }))
+                break;
         }
-        //recalculateGains(matrix);
     }
     
-    void solve(const vvint& matrix)
+    void solve(const connectivity& matrix)
     {
         while(1)
         {
@@ -198,15 +497,16 @@ private:
             std::vector<swappair> swapPairs;
             
             //Initializes A' and B' to the full partitions
-            ap = a; bp = b;
+            std::fill(unlocked.begin(), unlocked.end(), 1);
+            recomputeDValues();
             
-            for(unsigned i = 1; i != matrix.size()/2; ++i)
+            for(int i = 1; i < matrix.size()/2; ++i)
             {
                 auto swapPair = getBestSwapPair(matrix);
                 gate rm_a = std::get<0>(swapPair);
                 gate rm_b = std::get<1>(swapPair);            
-                ap.erase(rm_a);
-                bp.erase(rm_b);
+                unlocked[rm_a] = 0;
+                unlocked[rm_b] = 0;
                 swapPairs.emplace_back( swapPair );        
 
                 /* Else we need to update the D values for all gates that were connected to
@@ -216,24 +516,8 @@ private:
 
             /* After A' and B' are empty, we find a k to maximize g_max, the sum of gv[1],...,gv[k].
              * Then if g_max > 0, from 0 to k av and bv are swapped in a and b--the original partitions */             
-            auto kg_pair = getBestPartialSumKG(swapPairs);
-            int k_max = kg_pair.first;
-            int g_max = kg_pair.second;
-            if(g_max > 0) {
-                for(int i = 0; i != k_max+1; ++i) {
-                    gate swap_a = std::get<0>(swapPairs[i]);
-                    gate swap_b = std::get<1>(swapPairs[i]);    
-                    swapped[swap_a] = 1;
-                    swapped[swap_b] = 1;
-                    a.erase(swap_a);
-                    b.erase(swap_b);
-                    a.insert(swap_b);
-                    b.insert(swap_a);
-                }
-                recomputeDValues(matrix);
-            } else {
+            if(!applyBestPrefix(swapPairs, [&](gate g) { moveSettled(g, matrix); }))
                 break;
-            }
         }
     }
 };
@@ -241,13 +525,97 @@ private:
 
 /************************************************************************/
 
-std::pair<std::vector<int>,std::vector<int>> kernighanLinSolve(const std::vector<std::vector<int>>& matrix)
+//Pull of the terminals on gates that are not on the side they are pulled to
+static int terminalCost(const vint& pull, const vint& part)
+{
+    int cost = 0;
+    for(gate g = 0; g != pull.size(); ++g)
+        cost += std::max(0, part[g] == 0 ? pull[g] : -pull[g]);
+    return cost;
+}
+
+//Cut of a partition: connection weights across it, or the number of cut nets
+static int cutSize(const connectivity& matrix, const vint& part)
+{
+    int cut = 0;
+    for(int g = 0; g != matrix.size(); ++g)
+        for(int e = matrix.rowStart[g]; e != matrix.rowStart[g+1]; ++e)
+            if(part[matrix.columns[e]] != part[g])
+                cut += matrix.weights[e];
+    return cut / 2;
+}
+
+static int cutSize(const hypergraph& nets, const vint& part)
+{
+    int cut = 0;
+    for(int e = 0; e != nets.numNets(); ++e) {
+        int first = nets.netStart[e];
+        for(int p = first + 1; p != nets.netStart[e+1]; ++p)
+            if(part[nets.pins[p]] != part[nets.pins[first]]) {
+                cut += 1;
+                break;
+            }
+    }
+    return cut;
+}
+
+static vint solveFrom(const connectivity& matrix, const PartitionOptions& options, unsigned seed, const vint& pull)
 {
-    return KernighanLinSolver(matrix);
+    return KernighanLinSolver(matrix, options.threads, seed, pull).sides();
+}
+
+static vint solveFrom(const hypergraph& nets, const PartitionOptions&, unsigned seed, const vint& pull)
+{
+    return KernighanLinSolver(nets, seed, pull).sides();
+}
+
+/* Runs KL from `options.starts` initial partitions as tasks on the shared pool, and
+ * keeps the lowest cut. Start 0 is the usual half split and start s a random one
+ * seeded with s, so results are repeatable. Ties go to the lowest start. When
+ * `options.agree` starts have found the lowest cut so far, starts that have not
+ * begun yet are skipped */
+template<class Graph>
+static std::pair<vint,vint> kernighanLinSolve(const Graph& graph, const PartitionOptions& options, const vint& pull)
+{
+    unsigned starts = std::max(1u, options.starts);
+    vint best;
+    int bestCut = 0;
+    unsigned bestStart = 0, agreeing = 0;
+    std::mutex lock;
+    std::atomic<bool> done(false);
+
+    //Submitted last to first, as the pool runs a thread's newest task first
+    TaskGroup group;
+    for(unsigned s = starts; s-- != 0; ) {
+        group.run([&, s]() {
+            if(done)
+                return;
+            vint part = solveFrom(graph, options, s, pull);
+            int cut = cutSize(graph, part) + terminalCost(pull, part);
+
+            std::lock_guard<std::mutex> guard(lock);
+            if(best.empty() || cut < bestCut || (cut == bestCut && s < bestStart)) {
+                agreeing = (!best.empty() && cut == bestCut) ? agreeing + 1 : 1;
+                best = std::move(part);
+                bestCut = cut;
+                bestStart = s;
+            } else if(cut == bestCut) {
+                agreeing += 1;
+            }
+            if(options.agree != 0 && agreeing >= options.agree)
+                done = true;
+        });
+    }
+    group.wait();
+
+    std::pair<vint,vint> result;
+    for(gate g = 0; g != best.size(); ++g)
+        (best[g] == 0 ? result.first : result.second).push_back(g);
+    return result;
 }
 
 typedef std::pair<int,   vint> connpair;
-typedef std::pair<int,stdcell> cellpair;
+typedef std::pair<int,gate_instance> cellpair;
 
 //After the module is partitioned into submodules, the IOs are broken by `rebuildModule`
 //because they are directly copied from the src, and gates are removed from src.
@@ -265,32 +633,34 @@ void fixIOGates(module& m)
     auto allIns  = m.gates[2].inputs;
     auto allOuts = m.gates[2].outputs;
     for(unsigned i = 3; i < m.gates.size(); ++i) {
-        const stdcell& gi = m.gates[i];
+        const gate_instance& gi = m.gates[i];
         allIns.insert ( allIns.end(), gi.inputs.begin(),  gi.inputs.end());
         allOuts.insert(allOuts.end(), gi.outputs.begin(), gi.outputs.end());
     }
 
-    //We need to sort them to use set functions. Also remove duplicates from allI/allO
-    std::sort(inputs.begin(), inputs.end());
-    std::sort(outputs.begin(), outputs.end());
-    std::sort(allIns.begin(), allIns.end());
-    std::sort(allOuts.begin(), allOuts.end());
+    /* We need to sort them to use set functions. Also remove duplicates from allI/allO.
+     * Nets are sorted by name, the order the module's I/O is written out in */
+    netNameLess byName;
+    std::sort(inputs.begin(), inputs.end(), byName);
+    std::sort(outputs.begin(), outputs.end(), byName);
+    std::sort(allIns.begin(), allIns.end(), byName);
+    std::sort(allOuts.begin(), allOuts.end(), byName);
     allIns.resize(std::unique(allIns.begin(), allIns.end()) - allIns.begin());
     allOuts.resize(std::unique(allOuts.begin(), allOuts.end()) - allOuts.begin());
 
     //The IOs we want to keep are present in both allIns/allOuts and original non-partitioned inputs/outputs
-    std::set_intersection(allIns.begin(),   allIns.end(),  inputs.begin(),  inputs.end(), std::back_inserter(realIns));
-    std::set_intersection(allOuts.begin(), allOuts.end(), outputs.begin(), outputs.end(), std::back_inserter(realOuts));
+    std::set_intersection(allIns.begin(),   allIns.end(),  inputs.begin(),  inputs.end(), std::back_inserter(realIns), byName);
+    std::set_intersection(allOuts.begin(), allOuts.end(), outputs.begin(), outputs.end(), std::back_inserter(realOuts), byName);
 
     //All present in outputs that aren't present in any gate's input are new outputs of the module
-    std::set_difference(allOuts.begin(), allOuts.end(), allIns.begin(), allIns.end(), std::back_inserter(realOuts));
+    std::set_difference(allOuts.begin(), allOuts.end(), allIns.begin(), allIns.end(), std::back_inserter(realOuts), byName);
 
     //All present in inputs that don't come from any output are new inputs of the module
-    std::set_difference(allIns.begin(), allIns.end(), allOuts.begin(), allOuts.end(), std::back_inserter(realIns));
+    std::set_difference(allIns.begin(), allIns.end(), allOuts.begin(), allOuts.end(), std::back_inserter(realIns), byName);
 
     //The previous set operations may have duplicated things--resort and unique the ranges
-    std::sort(realIns.begin(), realIns.end());
-    std::sort(realOuts.begin(), realOuts.end());
+    std::sort(realIns.begin(), realIns.end(), byName);
+    std::sort(realOuts.begin(), realOuts.end(), byName);
     realIns.resize(std::unique(realIns.begin(), realIns.end()) - realIns.begin());
     realOuts.resize(std::unique(realOuts.begin(), realOuts.end()) - realOuts.begin());
 }
@@ -302,11 +672,10 @@ void rebuildModule(module& dest, const vint& gates, const module& src)
 {
     dest.name = src.name;
 
-    //Allocate space for the new connectivity matrix
+    //We are rebuilding the connectivity matrix to only those gates
+    //we should be keeping. We are transforming [g][h] into [i][j]
     int nGates = gates.size();
-    dest.connections.resize(nGates);
-    for(vint& row : dest.connections)
-        row.resize(nGates);
+    dest.connections = subConnectivity(src.connections, gates);
 
     for(int i = 0; i != nGates; ++i)
     {
@@ -315,16 +684,11 @@ void rebuildModule(module& dest, const vint& gates, const module& src)
         gate g = gates[i];
 
         //Copy a gate `g` over
-        dest.gates.push_back(src.gates[g]);
-
-        //We are rebuilding the connectivity matrix to only those gates
-        //we should be keeping. We are transforming [g][h] into [i][j]
-        for(int j = 0; j != nGates; ++j) {
-            gate h = gates[j];
-            dest.connections[i][j] += src.connections[g][h];
-        }
+        dest.addGate(src.gates[g], src.widths[g], src.lengths[g]);
     }
 
+    dest.hyperedges = subHypergraph(src.hyperedges, gates);
+
     //Now we need to fix IO gates (gates[0] and [1]) because some gates were removed
     fixIOGates(dest);
 }
@@ -350,17 +714,6 @@ void fixInterPartitionWires(module& r0, module& r1, const module& src)
 
 /****************************************************************/
 
-//Remedy for inputs and outputs gates being gates 0 and 1
-void removeIOGates(module& m)
-{
-    auto& conns = m.connections;
-    auto& gates = m.gates;
-    conns.erase(conns.begin(), conns.begin() + 2);
-    gates.erase(gates.begin(), gates.begin() + 2);
-    for(auto& row : conns)
-        row.erase(row.begin(), row.begin() + 2);
-}
-
 //Remedy. KL gives back a vint, we just insert 0 and 1 to say IO gates are there too
 //+2 becasue KL retutning the 0th gate is actaully the 2nd gate (no IO gates in KL)
 void insertIOGates(vint& partition)
@@ -371,15 +724,78 @@ void insertIOGates(vint& partition)
     partition.insert(partition.begin(), 0);    //Inptus gate
 }
 
+//Area of each gate of `view`, at least 1 so that every gate weighs something
+static vint gateAreas(const module_view& view)
+{
+    vint areas;
+    areas.reserve(view.gates.size());
+    for(int g : view.gates)
+        areas.push_back(std::max(1, int(view.netlist->widths[g] * view.netlist->lengths[g])));
+    return areas;
+}
+
+/* KL always splits the gate count in half, so for an area balance its split is
+ * evened out and refined on the gate areas with FM afterwards */
+template<class Graph>
+static std::pair<vint,vint> balanceAreas(const Graph& graph, const vint& areas, const std::pair<vint,vint>& split,
+    float balance, const vint& pull)
+{
+    vint side(areas.size(), 0);
+    for(int g : split.second)
+        side[g] = 1;
+    fiducciaMattheysesRefine(graph, areas, side, balance, pull);
+
+    std::pair<vint,vint> result;
+    for(gate g = 0; g != side.size(); ++g)
+        (side[g] == 0 ? result.first : result.second).push_back(g);
+    return result;
+}
+
+/* Splits the gates of `view` with the algorithm chosen in `options`. The result
+ * holds positions in view.gates, which are also the gates of the matrices built here.
+ * `pull` is the pull of terminals outside the view on each of its gates, if any */
+std::pair<vint,vint> bisect(const module_view& view, const PartitionOptions& options, const vint& pull = vint())
+{
+    const module& m = *view.netlist;
+    vint areas = options.areaBalance ? gateAreas(view) : vint();
+
+    //Multilevel always coarsens on connections, and refines on nets when asked to
+    if(options.algorithm == PartitionAlgorithm::Multilevel) {
+        connectivity matrix = subConnectivity(m.connections, view.gates);
+        if(options.hypergraph)
+            return multilevelSolve(matrix, subHypergraph(m.hyperedges, view.gates), areas, options.balance, pull);
+        return multilevelSolve(matrix, areas, options.balance, pull);
+    }
+
+    bool fm = options.algorithm == PartitionAlgorithm::FiducciaMattheyses;
+    if(options.hypergraph) {
+        hypergraph nets = subHypergraph(m.hyperedges, view.gates);
+        if(fm)
+            return fiducciaMattheysesSolve(nets, areas, options.balance, pull);
+        std::pair<vint,vint> split = kernighanLinSolve(nets, options, pull);
+        return areas.empty() ? split : balanceAreas(nets, areas, split, options.balance, pull);
+    }
+    connectivity matrix = subConnectivity(m.connections, view.gates);
+    if(fm)
+        return fiducciaMattheysesSolve(matrix, areas, options.balance, pull);
+    std::pair<vint,vint> split = kernighanLinSolve(matrix, options, pull);
+    return areas.empty() ? split : balanceAreas(matrix, areas, split, options.balance, pull);
+}
+
+//Maps positions in `view` back to gates of its netlist, in place
+static void viewGates(const module_view& view, vint& positions)
+{
+    for(int& g : positions)
+        g = view.gates[g];
+}
+
 /** Toplevel Kernighan Lin function **/
-std::pair<module, module> kernighanLin(const module& m)
+std::pair<module, module> kernighanLin(const module& m, const PartitionOptions& options)
 {
     module r0, r1;
-    module m_kl = m;
 
     //I/O gates are hidden from the KL algorithm...
-    removeIOGates(m_kl);
-    auto partitions = kernighanLinSolve(m_kl.connections);
+    std::pair<vint,vint> partitions = bisect(viewModule(m), options);
 
     //...Then we are inseting them back
     insertIOGates(partitions.first);
@@ -394,18 +810,51 @@ std::pair<module, module> kernighanLin(const module& m)
     return std::make_pair(std::move(r0), std::move(r1));
 }
 
+//Splits `view` into two views of the same netlist, with terminals pulling on its gates
+static std::pair<module_view, module_view> splitView(const module_view& view, const PartitionOptions& options,
+    const vint& pull)
+{
+    std::pair<vint,vint> partitions = bisect(view, options, pull);
+    viewGates(view, partitions.first);
+    viewGates(view, partitions.second);
+    return std::make_pair(module_view{ view.netlist, std::move(partitions.first) },
+                          module_view{ view.netlist, std::move(partitions.second) });
+}
+
+std::pair<module_view, module_view> kernighanLin(const module_view& view, const PartitionOptions& options)
+{
+    return splitView(view, options, vint());
+}
+
+module extractModule(const module& m, const vint& gates)
+{
+    module result;
+    vint partition = gates;
+    for(int& gate : partition)
+        gate -= 2;
+    insertIOGates(partition);
+    rebuildModule(result, partition, m);
+    return result;
+}
+
+module extractModule(const module_view& view)
+{
+    return extractModule(*view.netlist, view.gates);
+}
+
 /****************************************************************/
 
-std::pair<int,int> getModuleDimentions(const module& m, const PadframeFile& pad)
+std::pair<int,int> getModuleDimentions(const module_view& view, const PadframeFile& pad)
 {
+    const module& m = *view.netlist;
     int w=0, h=0, max_h=0;
     int slicewidth = (pad.usableWidth() / pad.slicesHoriz()) * 0.75;
 
     //Initial: width is sum of all widths, height is highest gate's height
-    for(const stdcell& g : m.gates)
-        w += g.length;
-    max_h = std::max_element(m.gates.begin(), m.gates.end(),
-            [](const stdcell& a, const stdcell& b) { return a.width < b.width; })->width;
+    for(int g : view.gates) {
+        w += m.lengths[g];
+        max_h = std::max<int>(max_h, m.widths[g]);
+    }
 
     /* h is the highest gate's height times the number of times w goes over
      * the slice wdith, or is only max_h if it does not go over */
@@ -416,42 +865,305 @@ std::pair<int,int> getModuleDimentions(const module& m, const PadframeFile& pad)
     return std::make_pair(w,h);
 }
 
-std::vector<module> kerninghanLinPadframeHelper(const module& m, const PadframeFile& f, int depth)
+//A rectangle of the padframe
+struct region
+{
+    float x0, y0, x1, y1;
+};
+
+/* Where a node of a slicing tree goes on the padframe. Each split cuts the node's
+ * region in two across its longer side, the first half taking the lower part. The
+ * k-way parts are laid out with the same cuts first, so every node of every part's
+ * tree has a path from the one root over the whole usable padframe */
+struct sliceplace
 {
-    std::vector<module> result;
+    int depth = 0;
+    unsigned long long path = 0;    //Half taken at each depth above the node, one bit each
+    region area = region{ 0, 0, 0, 0 };
+    std::vector<region> others;     //Region of the half not taken at each depth above the node
+};
+
+/* Which half every gate went to at each split so far, for terminal propagation. A
+ * gate's path bit for a depth is set before the halves of that split are handed
+ * out, and only the bits above a node's depth are ever read while it is split */
+struct terminalmap
+{
+    std::vector<char> sliced;   //Whether each gate is in the view being sliced
+    std::vector<std::atomic<unsigned long long>> path;
+
+    explicit terminalmap(int numGates) : sliced(numGates, 0), path(numGates)
+    {
+        for(auto& bits : path)
+            bits.store(0);
+    }
+};
 
+//Node of the recursive bisection. Leaves hold a finished part, and the rest their two halves
+struct slicenode
+{
+    module_view leaf;
+    std::unique_ptr<slicenode> halves[2];
+    sliceplace place;
+};
+
+//Whether a region is cut with a vertical line, through its longer side
+static bool cutsVertically(const region& r)
+{
+    return r.x1 - r.x0 >= r.y1 - r.y0;
+}
+
+//Half `h` of a region cut `fraction` of the way across its longer side
+static region halfOf(const region& r, int h, float fraction)
+{
+    region result = r;
+    if(cutsVertically(r))
+        (h == 0 ? result.x1 : result.x0) = r.x0 + (r.x1 - r.x0) * fraction;
+    else
+        (h == 0 ? result.y1 : result.y0) = r.y0 + (r.y1 - r.y0) * fraction;
+    return result;
+}
+
+static sliceplace childPlace(const sliceplace& parent, int h, float fraction = 0.5f)
+{
+    sliceplace child;
+    child.depth = parent.depth + 1;
+    child.path  = parent.path;
+    if(parent.depth < 64)
+        child.path |= static_cast<unsigned long long>(h) << parent.depth;
+    child.area  = halfOf(parent.area, h, fraction);
+    child.others = parent.others;
+    child.others.push_back(halfOf(parent.area, 1 - h, fraction));
+    return child;
+}
+
+/* Terminal propagation: connections from the gates of `view` to sliced gates that
+ * have already been split off elsewhere, in this part or another k-way part, pull
+ * the gates towards the half of `place` nearest the center of the region those
+ * gates went to. Positive pulls are towards the second half, as bisect expects */
+static vint terminalPull(const module_view& view, const terminalmap& terminals, const sliceplace& place)
+{
+    if(place.depth == 0 || place.depth >= 64)
+        return vint();
+
+    const connectivity& matrix = view.netlist->connections;
+    bool vertical = cutsVertically(place.area);
+    float cut = vertical ? (place.area.x0 + place.area.x1) / 2 : (place.area.y0 + place.area.y1) / 2;
+    unsigned long long mask = (1ULL << place.depth) - 1;
+
+    vint pull(view.gates.size(), 0);
+    for(unsigned i = 0; i != view.gates.size(); ++i) {
+        int g = view.gates[i];
+        for(int e = matrix.rowStart[g]; e != matrix.rowStart[g+1]; ++e) {
+            int x = matrix.columns[e];
+            if(!terminals.sliced[x])
+                continue;
+
+            //The lowest bit where the paths differ is the depth `x` left this node's path at
+            unsigned long long differ = (terminals.path[x].load(std::memory_order_relaxed) ^ place.path) & mask;
+            if(differ == 0)
+                continue;
+            int depth = 0;
+            while(!(differ & (1ULL << depth)))
+                ++depth;
+
+            const region& r = place.others[depth];
+            float center = vertical ? (r.x0 + r.x1) / 2 : (r.y0 + r.y1) / 2;
+            if(center > cut)
+                pull[i] += matrix.weights[e];
+            else if(center < cut)
+                pull[i] -= matrix.weights[e];
+        }
+    }
+    return pull;
+}
+
+/* Partitions `view` into `node` until every part fits in a padframe slice. One half
+ * is handed to the pool as a task, where idle threads can steal it, and the other
+ * is carried on with here. Parts are views of the one netlist, so a split only
+ * makes two gate lists, and a parent's list is freed as soon as it has been split.
+ * Each split is also a cut of the node's padframe region. With `terminals`, the
+ * half each gate took is recorded for the splits after it */
+void kerninghanLinPadframeHelper(std::shared_ptr<module_view> view, const PadframeFile& f,
+    const PartitionOptions& options, TaskGroup& group, slicenode& node, terminalmap* terminals)
+{
     int sliceWidth  = f.usableWidth()  / f.slicesHoriz();
     int sliceHeight = f.usableHeight() / f.slicesVert();
-    std::pair<int,int> dimensions = getModuleDimentions(m,f);
+    std::pair<int,int> dimensions = getModuleDimentions(*view,f);
 
     /* If the module is bigger than the padframe slice, we recursively
-     * partition it into two. Otherwise, return the entire module (base case) */
-
+     * partition it into two. Otherwise, keep the entire module (base case) */
     if(dimensions.first > sliceWidth || dimensions.second > sliceHeight)
     {
-        //Apply KL on this thread
-        auto partitions = kernighanLin(m);
+        vint pull = terminals ? terminalPull(*view, *terminals, node.place) : vint();
+        auto partitions = splitView(*view, options, pull);
+        auto first = std::make_shared<module_view>(std::move(partitions.first));
+        view = std::make_shared<module_view>(std::move(partitions.second));
+
+        node.halves[0].reset(new slicenode);
+        node.halves[1].reset(new slicenode);
+        for(int h = 0; h != 2; ++h)
+            node.halves[h]->place = childPlace(node.place, h);
+        if(terminals && node.place.depth < 64)
+            for(int g : view->gates)
+                terminals->path[g].fetch_or(1ULL << node.place.depth, std::memory_order_relaxed);
+
+        slicenode* firstNode = node.halves[0].get();
+        group.run([first, &f, &options, &group, firstNode, terminals]() {
+            kerninghanLinPadframeHelper(first, f, options, group, *firstNode, terminals);
+        });
 
-        //Spawn two threads to partition the two partitions
-        auto howToStart = depth < 4 ? std::launch::async : std::launch::deferred;
-        auto future0 = std::async(howToStart, kerninghanLinPadframeHelper, partitions.first,  f, depth+1);
-        auto future1 = std::async(howToStart, kerninghanLinPadframeHelper, partitions.second, f, depth+1);
+        //Continue with the second half on this thread
+        kerninghanLinPadframeHelper(std::move(view), f, options, group, *node.halves[1], terminals);
+        return;
+    }
+
+    //Base case: Module size is within slice w/h
+    node.leaf = std::move(*view);
+}
 
-        //Wait for the threads and combine their results
-        std::vector<module> parts0 = future0.get();
-        std::vector<module> parts1 = future1.get();
-        result.insert(result.end(), parts0.begin(), parts0.end());
-        result.insert(result.end(), parts1.begin(), parts1.end());
+//Appends the leaves under `node` to `result`, in order
+static void collectSlices(slicenode& node, std::vector<slicenode*>& result)
+{
+    if(!node.halves[0]) {
+        result.push_back(&node);
+        return;
     }
-    else {
-        //Base case: Module size is within slice w/h, we return only that module
-        result.push_back(std::move(m));
+    collectSlices(*node.halves[0], result);
+    collectSlices(*node.halves[1], result);
+}
+
+/* Gives each leaf a slice of the padframe, and returns the leaves' parts in the
+ * order of their slices, row by row from the lower left of the slice grid. Each
+ * leaf takes the free slice nearest the center of its region, in leaf order, and
+ * leaves past the last slice come after the rest, in leaf order */
+static std::vector<module_view> orderBySlice(const std::vector<slicenode*>& leaves, const PadframeFile& f)
+{
+    int columns = std::max(1, f.slicesHoriz()), rows = std::max(1, f.slicesVert());
+    float sliceWidth  = float(f.usableWidth())  / columns;
+    float sliceHeight = float(f.usableHeight()) / rows;
+
+    std::vector<char> taken(columns * rows, 0);
+    std::vector<std::pair<int,int>> order;     //(slice, leaf)
+    for(unsigned i = 0; i != leaves.size(); ++i) {
+        const region& r = leaves[i]->place.area;
+        float cx = (r.x0 + r.x1) / 2, cy = (r.y0 + r.y1) / 2;
+
+        int best = -1;
+        float bestDistance = 0;
+        for(int s = 0; s != columns * rows; ++s) {
+            if(taken[s])
+                continue;
+            float dx = std::fabs((s % columns + 0.5f) * sliceWidth  - cx);
+            float dy = std::fabs((s / columns + 0.5f) * sliceHeight - cy);
+            if(best == -1 || dx + dy < bestDistance) {
+                best = s;
+                bestDistance = dx + dy;
+            }
+        }
+        if(best == -1)
+            best = columns * rows + i;
+        else
+            taken[best] = 1;
+        order.push_back(std::make_pair(best, int(i)));
     }
+    std::sort(order.begin(), order.end());
 
+    std::vector<module_view> result;
+    for(const auto& entry : order)
+        result.push_back(std::move(leaves[entry.second]->leaf));
     return result;
 }
 
-std::vector<module> kerninghanLinPadframeSlice(const module &m, const PadframeFile &f)
+/* Splits `view` straight into parts for the padframe slices, weighing gates by
+ * their area. Only as many slices are used as hold the gates with `balance` of
+ * each slice to spare, so a small module is not spread over the whole padframe */
+static std::vector<module_view> kwaySlice(const module_view& view, const PadframeFile& f, const PartitionOptions& options)
+{
+    const module& m = *view.netlist;
+    int slices = f.slicesHoriz() * f.slicesVert();
+
+    //A slice holds its area in gates, less the width getModuleDimentions leaves free
+    int capacity = (f.usableWidth() / f.slicesHoriz()) * 0.75 * (f.usableHeight() / f.slicesVert());
+
+    vint weights = gateAreas(view);
+    int total = std::accumulate(weights.begin(), weights.end(), 0);
+
+    int bins = std::ceil(total * (1 + options.balance) / std::max(1, capacity));
+    bins = std::max(1, std::min({ bins, slices, int(view.gates.size()) }));
+    capacity = std::max<int>(capacity, std::ceil(total * (1 + options.balance) / bins));
+
+    vint bin = kwayPartition(subConnectivity(m.connections, view.gates), weights, bins, capacity);
+
+    //Gates keep their order in each part, and bins left empty by refinement are dropped
+    std::vector<module_view> parts(bins, module_view(view.netlist, vint()));
+    for(unsigned i = 0; i != view.gates.size(); ++i)
+        parts[bin[i]].gates.push_back(view.gates[i]);
+    parts.erase(std::remove_if(parts.begin(), parts.end(),
+        [](const module_view& part) { return part.gates.empty(); }), parts.end());
+    return parts;
+}
+
+/* Lays parts [first, last) out over `place`, cutting it in two for the first and
+ * second half of the parts, in proportion to how many parts each half has */
+static void placeParts(std::vector<slicenode>& roots, int first, int last, const sliceplace& place)
+{
+    if(last - first == 1) {
+        roots[first].place = place;
+        return;
+    }
+    int mid = first + (last - first) / 2;
+    float fraction = float(mid - first) / (last - first);
+    placeParts(roots, first, mid, childPlace(place, 0, fraction));
+    placeParts(roots, mid, last, childPlace(place, 1, fraction));
+}
+
+std::vector<module_view> kerninghanLinPadframeSlice(const module_view& view, const PadframeFile& f,
+    const PartitionOptions& options)
+{
+    //Every k-way part is bisected further if it needs to be, each from its own task
+    std::vector<module_view> parts;
+    if(options.kway && !view.gates.empty())
+        parts = kwaySlice(view, f, options);
+    else
+        parts.push_back(view);
+
+    //The parts' trees each start out over their own region of the usable padframe
+    std::vector<slicenode> roots(parts.size());
+    sliceplace padframe;
+    padframe.area = region{ 0, 0, float(f.usableWidth()), float(f.usableHeight()) };
+    placeParts(roots, 0, roots.size(), padframe);
+
+    //A part's gates start from the path to its region, so other parts' gates pull towards it
+    std::unique_ptr<terminalmap> terminals;
+    if(options.terminals) {
+        terminals.reset(new terminalmap(view.netlist->gates.size()));
+        for(unsigned i = 0; i != parts.size(); ++i) {
+            for(int g : parts[i].gates) {
+                terminals->sliced[g] = 1;
+                terminals->path[g].store(roots[i].place.path);
+            }
+        }
+    }
+
+    TaskGroup group;
+    for(unsigned i = 0; i != parts.size(); ++i) {
+        auto part = std::make_shared<module_view>(std::move(parts[i]));
+        slicenode* root = &roots[i];
+        terminalmap* map = terminals.get();
+        group.run([part, &f, &options, &group, root, map]() {
+            kerninghanLinPadframeHelper(part, f, options, group, *root, map);
+        });
+    }
+    group.wait();
+
+    std::vector<slicenode*> leaves;
+    for(slicenode& root : roots)
+        collectSlices(root, leaves);
+    return orderBySlice(leaves, f);
+}
+
+std::vector<module_view> kerninghanLinPadframeSlice(const module& m, const PadframeFile& f,
+    const PartitionOptions& options)
 {
-    return kerninghanLinPadframeHelper(m, f, 0);
+    return kerninghanLinPadframeSlice(viewModule(m), f, options);
 }
@@ -4,18 +4,83 @@
 #include "module.h"
 #include "padframe.h"
 
-/* Implementation of the Kernighan–Lin two-way graph partitioning algorithm.
+//Two-way partitioning algorithms a module can be split with
+enum class PartitionAlgorithm
+{
+    KernighanLin,
+    FiducciaMattheyses,
+    Multilevel
+};
+
+//Options for how modules are partitioned
+struct PartitionOptions
+{
+    /* Partition on the module's net hypergraph, counting cut nets, instead
+     * of on the clique-expanded connectivity matrix */
+    bool hypergraph = false;
+
+    //Algorithm used for each two-way split
+    PartitionAlgorithm algorithm = PartitionAlgorithm::KernighanLin;
+
+    /* How far from half of the gates each side of an FM or multilevel split may
+     * be, as a fraction of all gates. KL always splits the gates exactly in half.
+     * For k-way slicing, the fraction of a slice's area left free for refinement */
+    float balance = 0.1f;
+
+    /* Balance each split on cell area (width * length) instead of gate count, with
+     * `balance` as a fraction of the area. KL splits are evened out with FM after */
+    bool areaBalance = false;
+
+    /* Partition straight into up to one part per padframe slice, on cell areas and
+     * gate connections, before any bisection. Parts that still do not fit in a
+     * slice are then split with `algorithm` as usual */
+    bool kway = false;
+
+    /* Terminal propagation while slicing: each split is a cut of its part's region
+     * of the padframe, and connections to gates already split off to other regions
+     * pull gates towards the half nearest them */
+    bool terminals = false;
+
+    //Threads KL may split its best swap pair search over on large modules
+    unsigned threads = 1;
+
+    /* Number of initial partitions KL is run from, in parallel, keeping the lowest
+     * cut. The first is the usual half split, and the rest are seeded random splits */
+    unsigned starts = 1;
+
+    //Stop starting KL runs once this many have found the lowest cut, or 0 to run all of them
+    unsigned agree = 0;
+};
+
+/* Implementation of the Kernighan–Lin two-way graph partitioning algorithm, or
+ * of the algorithm chosen in `options`.
  * Input: A module to be partitioned
  * Output: Two modules, partition A and partition B of the module */
 
-std::pair<module,module> kernighanLin(const module& m);
+std::pair<module,module> kernighanLin(const module& m, const PartitionOptions& options = PartitionOptions());
+
+//Same as above, but splits a view into two views of the same netlist
+std::pair<module_view,module_view> kernighanLin(const module_view& view,
+    const PartitionOptions& options = PartitionOptions());
+
+/* Builds the module made of only `gates` of `m`, with its connectivity and I/O
+ * gates rebuilt. Indices in `gates` are into m.gates and skip the I/O gates 0 and 1 */
+
+module extractModule(const module& m, const std::vector<int>& gates);
+module extractModule(const module_view& view);
 
 /* Kerninghan-Lin two-way partitioning algorithm, but continues to recursively partition a
  * moudule in two until mostly all areas are less than the area of a usable padfram slice
- * Input: A module to partition and a padframe to judge width/lengths
- * Output: K partitions, each corresponding to <= a slice width/height
+ * Input: A module (or a view of one) to partition and a padframe to judge width/lengths
+ * Output: K partitions, each corresponding to <= a slice width/height, as views of
+ *  the same netlist. Gates keep their relative order within each partition. Each
+ *  partition is given the padframe slice nearest the region its splits cut out for
+ *  it, and partitions come out in slice order, row by row from the lower left
  */
 
-std::vector<module> kerninghanLinPadframeSlice(const module& m, const PadframeFile& f);
+std::vector<module_view> kerninghanLinPadframeSlice(const module& m, const PadframeFile& f,
+    const PartitionOptions& options = PartitionOptions());
+std::vector<module_view> kerninghanLinPadframeSlice(const module_view& view, const PadframeFile& f,
+    const PartitionOptions& options = PartitionOptions());
 
 #endif
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <numeric>
+#include "kway.h"
+
+#define KWAY_MAX_PASSES     8       //Refinement stops after this many passes even if gates still move
+
+//Type definitions used in this file
+typedef std::vector<int> vint;
+
+/* Orders the gates breadth first over their connections, starting again from the
+ * first gate not yet reached whenever a connected component runs out. Gates
+ * close together in the order are close together in the graph */
+static vint breadthFirstOrder(const connectivity& matrix)
+{
+    int n = matrix.size();
+    vint order, reached(n, 0);
+    order.reserve(n);
+
+    for(int start = 0; start != n; ++start) {
+        if(reached[start])
+            continue;
+        reached[start] = 1;
+        order.push_back(start);
+        for(size_t q = order.size() - 1; q != order.size(); ++q) {
+            int g = order[q];
+            for(int e = matrix.rowStart[g]; e != matrix.rowStart[g+1]; ++e) {
+                int x = matrix.columns[e];
+                if(!reached[x]) {
+                    reached[x] = 1;
+                    order.push_back(x);
+                }
+            }
+        }
+    }
+    return order;
+}
+
+//Cuts the breadth first order into `k` runs, each taking an even share of the weight left
+static vint initialBins(const connectivity& matrix, const vint& weights, int k)
+{
+    vint order = breadthFirstOrder(matrix);
+    vint bin(matrix.size(), k - 1);
+    int left = std::accumulate(weights.begin(), weights.end(), 0);
+
+    size_t i = 0;
+    for(int b = 0; b < k - 1 && i != order.size(); ++b) {
+        int share = (left + (k - b) - 1) / (k - b);
+        int load = 0;
+        while(load < share && i != order.size()) {
+            bin[order[i]] = b;
+            load += weights[order[i]];
+            ++i;
+        }
+        left -= load;
+    }
+    return bin;
+}
+
+/* One greedy k-way pass. Every gate goes to the bin it has the most connection
+ * weight to, if that is more than it has to its own bin, or to an equally good bin
+ * that ends up lighter than its own was. Ties go to the lightest bin after the move.
+ * Every move lowers the cut or evens out the loads, so passes cannot cycle.
+ * Returns the number of gates moved */
+static int refinePass(const connectivity& matrix, const vint& weights, int capacity, vint& bin, vint& load)
+{
+    int moved = 0;
+    vint linked(load.size(), 0), touched;
+    for(int g = 0; g != matrix.size(); ++g)
+    {
+        //Connection weight from `g` to each bin it touches
+        int from = bin[g];
+        for(int e = matrix.rowStart[g]; e != matrix.rowStart[g+1]; ++e) {
+            int x = matrix.columns[e];
+            if(x == g)
+                continue;
+            if(linked[bin[x]] == 0)
+                touched.push_back(bin[x]);
+            linked[bin[x]] += matrix.weights[e];
+        }
+
+        //Staying put is a gain of 0, with `g` adding to its own bin's load
+        int best = from, bestGain = 0, bestLoad = load[from];
+        for(int b : touched) {
+            int gain = linked[b] - linked[from];
+            int after = load[b] + weights[g];
+            if(b == from || after > capacity)
+                continue;
+            if(gain > bestGain || (gain == bestGain && after < bestLoad)) {
+                best = b;
+                bestGain = gain;
+                bestLoad = after;
+            }
+        }
+
+        for(int b : touched)
+            linked[b] = 0;
+        touched.clear();
+
+        if(best != from) {
+            load[from] -= weights[g];
+            load[best] += weights[g];
+            bin[g] = best;
+            ++moved;
+        }
+    }
+    return moved;
+}
+
+/************************************************************************/
+
+vint kwayPartition(const connectivity& matrix, const vint& weights, int k, int capacity)
+{
+    k = std::max(1, k);
+    vint bin = initialBins(matrix, weights, k);
+
+    vint load(k, 0);
+    for(int g = 0; g != matrix.size(); ++g)
+        load[bin[g]] += weights[g];
+
+    for(int pass = 0; pass != KWAY_MAX_PASSES; ++pass)
+        if(refinePass(matrix, weights, capacity, bin, load) == 0)
+            break;
+    return bin;
+}
@@ -0,0 +1,16 @@
+#ifndef KWAY_H
+#define KWAY_H
+#include <vector>
+#include "connectivity.h"
+
+/* Direct k-way partitioning. The gates are laid out breadth first over their
+ * connections and cut into `k` runs of about equal weight, then refined with
+ * greedy k-way passes: each gate moves to the bin it is most connected to, if
+ * that lowers the cut and the bin stays within `capacity`.
+ * Input: The gate connections, the weight of each gate, the number of bins and
+ *        the most weight a bin may hold after refinement
+ * Output: The bin of every gate, from 0 to k-1 */
+
+std::vector<int> kwayPartition(const connectivity& matrix, const std::vector<int>& weights, int k, int capacity);
+
+#endif
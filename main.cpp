@@ -1,4 +1,6 @@
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
 #include "stdcell.h"
 #include "padframe.h"
 #include "floorplan.h"
@@ -6,6 +8,80 @@
 #include "utility.h"
 #include "kerninghan.h"
 #include "output.h"
+#include "netcache.h"
+#include "eco.h"
+#include "usf_ami05_cells.h"
+
+//Loads a standard cell file, or the compiled in library when it is "@usf_ami05"
+MattCellFile loadCells(const std::string& cellFile)
+{
+    if(cellFile == "@usf_ami05")
+        return MattCellFile("usf_ami05", usf_ami05_cells, usf_ami05_cell_count);
+    return MattCellFile(cellFile);
+}
+
+/* Loads the modules of `moduleFile` into `modules`, and returns the cell library they
+ * were read with. With `useCache`, a netlist cache next to the module file is used
+ * instead of parsing both files when neither has changed, and is rewritten when they have */
+MattCellFile loadModules(const std::string& cellFile, const std::string& moduleFile, bool parallel,
+    bool useCache, std::vector<module>& modules)
+{
+    std::vector<stdcell> cellDefinitions;
+    bool builtin = (cellFile == "@usf_ami05");
+    NetlistCache cache(cellFile, moduleFile, builtin ? usf_ami05_cells : nullptr, builtin ? usf_ami05_cell_count : 0);
+    if(useCache && cache.load(cellDefinitions, modules))
+        return MattCellFile(builtin ? "usf_ami05" : cellFile, cellDefinitions);
+
+    MattCellFile cells = loadCells(cellFile);
+    modules = parallel ? readModuleFileParallel(moduleFile, cells) : readModuleFile(moduleFile, cells);
+    if(useCache)
+        cache.save(cells, modules);
+    return cells;
+}
+
+/* Partitions and floorplans one module, read with `cells`, writing the result to
+ * unity<suffix>.out and partitions<suffix>.out. Given the partitions file of a previous run in `ecoFile`,
+ * only the partitions touched by changes to the netlist are redone. The area and
+ * wire length of all partitions' floorplans are summed into `cost` */
+std::vector<polish_string> partitionAndFloorplan(const module& m, const MattCellFile& cells,
+    const PadframeFile& f, const PartitionOptions& options, const FloorplanOptions& floorplanOptions,
+    const std::string& suffix, const std::string& ecoFile, slicing_cost& cost)
+{
+    std::vector<module_view> partitions;
+    std::vector<polish_string> polishes;
+
+    if(ecoFile.empty()) {
+        //Partition module into slice-sizes modules
+        partitions = kerninghanLinPadframeSlice(m, f, options);
+
+        //Floorplan all modules
+        polishes = floorplan_all(partitions, floorplanOptions);
+    } else {
+        int reused = ecoPartitionAndFloorplan(m, cells, f, options, floorplanOptions,
+            readPartitionFile(ecoFile), partitions, polishes);
+        std::cout << "ECO reused " << reused << " of " << partitions.size() << " partitions" << std::endl;
+    }
+
+    //Write out unity, and the partitions for later ECO runs
+    UnityFile unity("unity" + suffix + ".out", cells);
+    unity.write(partitions, polishes);
+    PartitionFile partitionFile("partitions" + suffix + ".out", cells);
+    partitionFile.write(partitions, polishes);
+
+    cost = slicing_cost();
+    for(unsigned i = 0; i != partitions.size(); ++i) {
+        slicing_cost c = floorplanCost(partitions[i], polishes[i], floorplanOptions);
+        cost.area += c.area;
+        cost.wirelength += c.wirelength;
+    }
+    return polishes;
+}
+
+//Prints the summed area and wire length of a model's floorplans
+void printCost(const slicing_cost& cost)
+{
+    std::cout << "Floorplan area " << cost.area << ", wire length " << cost.wirelength << std::endl;
+}
 
 #if 1
 int main(int argc, char** argv)
@@ -14,34 +90,100 @@ int main(int argc, char** argv)
     if(argc < 4) {
         std::cout
             << "Usage: " << argv[0]
-            << " <stdcell file> <module file> <padframe file>" << std::endl;
+            << " <stdcell file> <module file> <padframe file> [-all] [-cache] [-hypergraph] [-fm] [-multilevel] [-area] [-balance <f>] [-kway] [-terminals] [-klthreads <n>] [-klstarts <n>] [-klagree <n>] [-hpwl] [-eco <file>]" << std::endl
+            << "  <stdcell file> may be @usf_ami05 to use the library compiled into the program" << std::endl
+            << "  -all         Load and process every model in the module file in parallel,"
+            << " writing unity_<model>.out and partitions_<model>.out for each" << std::endl
+            << "  -cache       Keep the parsed input files in <module file>.cache, and load them"
+            << " from it while neither file has changed" << std::endl
+            << "  -hypergraph  Partition on net hyperedges instead of gate-to-gate connections" << std::endl
+            << "  -fm          Split modules with Fiduccia-Mattheyses instead of Kernighan-Lin" << std::endl
+            << "  -multilevel  Split modules with multilevel coarsening and FM refinement" << std::endl
+            << "  -area        Balance each split on cell area instead of gate count" << std::endl
+            << "  -balance <f> How far from an even split each side may be, as a fraction (default 0.1)" << std::endl
+            << "  -kway        Partition straight into padframe slices before any bisection" << std::endl
+            << "  -terminals   Pull gates towards the side of each cut their connections were placed on" << std::endl
+            << "  -klthreads <n>  Search for KL swap pairs on <n> threads when modules are large" << std::endl
+            << "  -klstarts <n>  Run KL from <n> initial partitions in parallel, keeping the best" << std::endl
+            << "  -klagree <n>   Stop starting KL runs once <n> of them found the same best cut" << std::endl
+            << "  -hpwl        Measure floorplan wire length as net half perimeters instead of"
+            << " connections times distance" << std::endl
+            << "  -eco <file>  Reuse the partitions in a previous run's partitions.out that the"
+            << " netlist changes did not touch" << std::endl;
         return 1;
     }
 
     srand(time(NULL));
+    bool allModels = false, useCache = false;
+    std::string ecoFile;
+    PartitionOptions options;
+    FloorplanOptions floorplanOptions;
+    for(int i = 4; i < argc; ++i) {
+        std::string arg = argv[i];
+        allModels = allModels || (arg == "-all");
+        useCache  = useCache  || (arg == "-cache");
+        options.hypergraph = options.hypergraph || (arg == "-hypergraph");
+        if(arg == "-fm")
+            options.algorithm = PartitionAlgorithm::FiducciaMattheyses;
+        if(arg == "-multilevel")
+            options.algorithm = PartitionAlgorithm::Multilevel;
+        options.kway = options.kway || (arg == "-kway");
+        options.areaBalance = options.areaBalance || (arg == "-area");
+        options.terminals = options.terminals || (arg == "-terminals");
+        if(arg == "-balance" && i+1 < argc)
+            options.balance = std::max(0.0, atof(argv[++i]));
+        if(arg == "-klthreads" && i+1 < argc)
+            options.threads = std::max(1, atoi(argv[++i]));
+        if(arg == "-klstarts" && i+1 < argc)
+            options.starts = std::max(1, atoi(argv[++i]));
+        if(arg == "-klagree" && i+1 < argc)
+            options.agree = std::max(0, atoi(argv[++i]));
+        if(arg == "-hpwl")
+            floorplanOptions.metric = WireMetric::HalfPerimeter;
+        if(arg == "-eco" && i+1 < argc)
+            ecoFile = argv[++i];
+    }
 
     try 
     {
         //Loads all files and information
-        MattCellFile cells(argv[1]);
-        std::vector<module> modules = readModuleFile(argv[2], cells);
+        std::vector<module> modules;
+        MattCellFile cells = loadModules(argv[1], argv[2], allModels, useCache, modules);
         PadframeFile f(argv[3]);
 
-        //Partition module into slice-sizes modules
-        std::cout << "Partitioning..." << std::endl;
-        std::vector<module> partitions = kerninghanLinPadframeSlice(modules[0], f);
+        if(allModels && !ecoFile.empty())
+            error("-eco works on a single model, and can not be used with -all");
 
-        //Floorplan all modules
-        std::cout << "Floorplanning..." << std::endl;
-        auto polishes = floorplan_all(partitions);
+        if(allModels)
+        {
+            //Each model is partitioned and floorplanned on its own thread
+            std::cout << "Partitioning and floorplanning " << modules.size() << " models..." << std::endl;
+            std::vector<std::vector<polish_string>> polishes(modules.size());
+            std::vector<slicing_cost> costs(modules.size());
+            parallelFor(modules.size(), [&](unsigned i) {
+                polishes[i] = partitionAndFloorplan(modules[i], cells, f, options, floorplanOptions,
+                    "_" + modules[i].name, "", costs[i]);
+            });
 
-        //Write out unity
-        UnityFile unity("unity.out");
-        unity.write(partitions, polishes);
+            //Print out results
+            for(unsigned i = 0; i != modules.size(); ++i) {
+                std::cout << modules[i].name << std::endl;
+                for(polish_string& s : polishes[i])
+                    std::cout << s << std::endl;
+                printCost(costs[i]);
+            }
+        }
+        else
+        {
+            std::cout << "Partitioning and floorplanning..." << std::endl;
+            slicing_cost cost;
+            auto polishes = partitionAndFloorplan(modules[0], cells, f, options, floorplanOptions, "", ecoFile, cost);
 
-        //Print out results
-        for(polish_string& s : polishes)
-            std::cout << s << std::endl;
+            //Print out results
+            for(polish_string& s : polishes)
+                std::cout << s << std::endl;
+            printCost(cost);
+        }
     }
     catch(std::exception& e) {
         std::cerr << e.what() << std::endl;
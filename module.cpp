@@ -1,54 +1,78 @@
 #include <iostream>
 #include <algorithm>
+#include <iterator>
 #include <string>
 #include <vector>
-#include <fstream>
+#include <unordered_map>
 #include "utility.h"
 #include "stdcell.h"
 #include "module.h"
 
+void module::addGate(const gate_instance& gate, float width, float length)
+{
+    gates.push_back(gate);
+    widths.push_back(width);
+    lengths.push_back(length);
+}
+
+module_view viewModule(const module& m)
+{
+    module_view view;
+    view.netlist = &m;
+    for(int g = 2; g < int(m.gates.size()); ++g)
+        view.gates.push_back(g);
+    return view;
+}
+
+/* Builds the connectivity matrix of each module from a net index. Every net name
+ * maps to the list of gates that take it as an input (once per input pin), so each
+ * gate output only visits the gates it actually drives. Runs in roughly linear time
+ * in the number of pins instead of comparing every output against every input. */
 void cellIO(std::vector<module>& m)
 {
     //go through all structures
     for(unsigned i=0; i<m.size(); ++i)
     {
-        //Get gates and resize the connectivity matirx
-        std::vector<stdcell>& g = m[i].gates;
-        m[i].connections.resize(g.size());
-        for(std::vector<int>& row : m[i].connections)
-            row.resize(g.size());
+        //Get gates and the connections found between them
+        std::vector<gate_instance>& g = m[i].gates;
+        std::vector<connentry> entries;
+
+        //Net index: net -> gates with an input pin on that net
+        std::unordered_map<netid, std::vector<unsigned>> sinks;
+        for(unsigned l=0; l<g.size(); ++l)
+            for(netid input : g[l].inputs)
+                sinks[input].push_back(l);
 
-        //for each gates in module m[i]
+        //for each gate output, connect to every gate sinking that net
         for(unsigned j=0; j<g.size(); ++j)
         {
-            //for each gate output, find a gate with the proper input
-            for(unsigned k=0; k<g[j].outputs.size(); ++k)
+            for(netid output : g[j].outputs)
             {
-                //check array of gates in this model
-                for(unsigned l=0; l<g.size(); ++l)
+                auto it = sinks.find(output);
+                if(it == sinks.end())
+                    continue;
+                for(unsigned l : it->second)
                 {
-                    //for each input
-                    for(unsigned n=0; n<g[l].inputs.size(); ++n)
-                    {
-                        if(g[j].outputs[k] == g[l].inputs[n])
-                        {
-                            //Here we've found a match from an output to an input
-                            m[i].connections[j][l] += 1;
-                            m[i].connections[l][j] += 1;    //To be symmetric
-                        }
-                    }
+                    //Here we've found a match from an output to an input
+                    entries.push_back(connentry{ int(j), int(l), 1 });
+                    entries.push_back(connentry{ int(l), int(j), 1 });    //To be symmetric
                 }
             }
         }
+
+        //Sum repeated connections into the sparse connectivity matrix
+        m[i].connections = buildConnectivity(g.size(), entries);
+        m[i].hyperedges  = buildHypergraph(g);
     }
 }
 
-std::pair<std::string, std::string> getGateIONames(const std::string& fullIOName)
+//Parses the A=[B] or A=B pin token into "gateName" A and "connectName" B, without copying
+std::pair<string_ref, string_ref> getGateIONames(const string_ref& fullIOName)
 {
     size_t equalPos   = fullIOName.find('=');
     size_t bracketPos = fullIOName.find('[');
-    std::string gateName = fullIOName.substr(0, equalPos);
-    std::string connName;
+    string_ref gateName = fullIOName.substr(0, equalPos);
+    string_ref connName;
     if(bracketPos != std::string::npos) {
         connName = fullIOName.substr(bracketPos+1, fullIOName.find(']') - (bracketPos+1));
     } else {
@@ -57,95 +81,149 @@ std::pair<std::string, std::string> getGateIONames(const std::string& fullIOName
     return std::make_pair(gateName, connName);
 }
 
-std::vector<module> readModuleFile(const std::string& fileName, const MattCellFile& cells)
+/* Parses the models in the range [begin, end) of a .netblif file, without their
+ * connectivity. `lineCount` is the line number the range starts after, for errors */
+std::vector<module> parseModels(const char* begin, const char* end, const std::string& fileName,
+    const MattCellFile& cells, int lineCount)
 {
-    static const std::string delim = " \t";
-
     std::vector<module> allModels;
-    std::ifstream stream(fileName);
-    std::string line;
     module tmpModel;
-    int lineCount = 0;    //Which line we are on
-    
-    if(!stream.is_open()) {
-        error("Could not open netlibf module file \"", fileName, "\"");
-    }
     
+    //Tokens of each line point into the file, and the vector is reused for every line
+    LineTokenizer lines(begin, end);
+    std::vector<string_ref> tokens;
     int linesRead;
-    while(getline_fixed(stream, line, linesRead))
+    while(lines.next(tokens, linesRead))
     {
         lineCount += linesRead;
+        if(tokens.empty())
+            continue;
+        const string_ref& keyword = tokens[0];
     
-        if(line.find(".model") != std::string::npos)
+        if(keyword == ".model")
         {
-            std::vector<std::string> tmpName = Split(line, delim);
-            tmpModel.name = tmpName[1];
+            if(tokens.size() > 1)
+                tmpModel.name = tokens[1].str();
         }
-        else if(line.find(".inputs") != std::string::npos)
+        else if(keyword == ".inputs")
         {
-            stdcell tmpCell;
-            std::vector<std::string> inputInfo = Split(line, delim);
-            tmpCell.name = "inputs";
-            for(unsigned i=1; i<inputInfo.size(); ++i) {
-                tmpCell.outputs.push_back(inputInfo[i]);
+            gate_instance tmpCell;
+            tmpCell.cell = CELL_INPUTS;
+            for(unsigned i=1; i<tokens.size(); ++i) {
+                tmpCell.outputs.push_back(nets().intern(tokens[i]));
             }
-            tmpModel.gates.push_back(tmpCell);
+            tmpModel.addGate(tmpCell, 0, 0);
         }
-        else if(line.find(".outputs") != std::string::npos)
+        else if(keyword == ".outputs")
         {
-            stdcell tmpCell;
-            std::vector<std::string> outputInfo = Split(line, delim);
-            tmpCell.name = "outputs";
-            for(unsigned i=1; i<outputInfo.size(); ++i) {
-                tmpCell.inputs.push_back(outputInfo[i]);
+            gate_instance tmpCell;
+            tmpCell.cell = CELL_OUTPUTS;
+            for(unsigned i=1; i<tokens.size(); ++i) {
+                tmpCell.inputs.push_back(nets().intern(tokens[i]));
             }
-            tmpModel.gates.push_back(tmpCell);
+            tmpModel.addGate(tmpCell, 0, 0);
         }
-        else if(line.find(".gate") != std::string::npos)
+        else if(keyword == ".gate")
         {
-            stdcell tmpCell;
-            std::vector<std::string> gateInfo = Split(line, delim);
-            tmpCell.name = gateInfo[1];
+            gate_instance tmpCell;
+            if(tokens.size() < 2) {
+                error(fileName, ":", lineCount, ": ", ".gate is missing a standard cell name");
+            }
 
-            for(unsigned i=2; i<gateInfo.size(); ++i)
-            {
-                //Map lookup standard cell information and fill tmpCell
-                const stdcell& cell = cells[tmpCell.name];    
-                tmpCell.width = cell.width;
-                tmpCell.length = cell.length;
-                const std::vector<std::string>& outs = cell.outputs;
-                const std::vector<std::string>& ins = cell.inputs;
+            //Hash lookup standard cell information once and fill tmpCell
+            int cellIndex = cells.index(tokens[1]);
+            const stdcell& cell = cells.at(cellIndex);
+            tmpCell.cell = cellIndex;
 
+            for(unsigned i=2; i<tokens.size(); ++i)
+            {
                 //Parses the A=[B] or A=B string into "gateName" A and "connectName" B
-                auto connectName = getGateIONames(gateInfo[i]);
+                auto connectName = getGateIONames(tokens[i]);
                 
-                /* Look for the "gateName" in the cell's gate outputs. If it is there, then it is 
-                 * connected to `connectName` through that gate pin. Push back into outputs/inputs 
+                /* Look up the "gateName" pin of the cell. If it is there, then it is connected
+                 * to `connectName` through that gate pin. Push back into outputs/inputs 
                  */
-                if(std::find(outs.begin(), outs.end(), connectName.first) != outs.end()) {
-                    tmpCell.outputs.push_back(connectName.second);
-                } 
-                else if(std::find(ins.begin(), ins.end(), connectName.first) != ins.end()) {
-                    tmpCell.inputs.push_back(connectName.second);
+                stdcell_pin pin;
+                if(cells.findPin(cellIndex, nets().find(connectName.first), pin)) {
+                    (pin.output ? tmpCell.outputs : tmpCell.inputs).push_back(nets().intern(connectName.second));
                 }
                 else {
                     error(fileName, ":", lineCount, ": ", "Pin connection \"", connectName.first, 
-                        "\" did not match any pin on cell \"", tmpCell.name, "\" ", 
-                        cell.inputs, cell.outputs); 
+                        "\" did not match any pin on cell \"", cell.name, "\" ", 
+                        netNames(cell.inputs), netNames(cell.outputs)); 
                 }
             }
 
-            tmpModel.gates.push_back(tmpCell);
+            tmpModel.addGate(tmpCell, cell.width, cell.length);
         }
-        else if(line.find(".end") != std::string::npos)
+        else if(keyword == ".end")
         {
             allModels.push_back(tmpModel);
-            tmpModel.name = "";
-            tmpModel.gates.clear();
+            tmpModel = module();
         }
     }
     
+    return allModels;
+}
+
+std::vector<module> readModuleFile(const std::string& fileName, const MattCellFile& cells, bool useMmap)
+{
+    MappedFile file(fileName, useMmap);
+    if(!file.isOpen()) {
+        error("Could not open netlibf module file \"", fileName, "\"");
+    }
+
+    std::vector<module> allModels = parseModels(file.begin(), file.end(), fileName, cells, 0);
     cellIO(allModels);
 
     return allModels;
 }
+
+std::vector<module> readModuleFileParallel(const std::string& fileName, const MattCellFile& cells, bool useMmap)
+{
+    //A .model to .end range of the file, and the line it starts after
+    struct modelRange {
+        const char* begin;
+        const char* end;
+        int lineCount;
+    };
+
+    MappedFile file(fileName, useMmap);
+    if(!file.isOpen()) {
+        error("Could not open netlibf module file \"", fileName, "\"");
+    }
+
+    //Split the file on .model/.end boundaries. This only tokenizes, which is cheap
+    std::vector<modelRange> ranges;
+    LineTokenizer lines(file.begin(), file.end());
+    std::vector<string_ref> tokens;
+    const char* lineStart = lines.position();
+    int lineCount = 0, linesRead;
+    while(lines.next(tokens, linesRead))
+    {
+        if(!tokens.empty() && tokens[0] == ".model") {
+            if(!ranges.empty() && ranges.back().end == file.end())
+                ranges.back().end = lineStart;    //Previous model had no .end
+            ranges.push_back(modelRange{ lineStart, file.end(), lineCount });
+        }
+        else if(!tokens.empty() && tokens[0] == ".end" && !ranges.empty()) {
+            ranges.back().end = lines.position();
+        }
+        lineCount += linesRead;
+        lineStart = lines.position();
+    }
+
+    //Parse each model and build its connectivity on its own thread
+    std::vector<std::vector<module>> parsed(ranges.size());
+    parallelFor(ranges.size(), [&](unsigned i) {
+        parsed[i] = parseModels(ranges[i].begin, ranges[i].end, fileName, cells, ranges[i].lineCount);
+        cellIO(parsed[i]);
+    });
+
+    //Models without an .end are dropped, the same as readModuleFile
+    std::vector<module> allModels;
+    for(std::vector<module>& models : parsed)
+        std::move(models.begin(), models.end(), std::back_inserter(allModels));
+
+    return allModels;
+}
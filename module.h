@@ -3,26 +3,63 @@
 
 #include <string>
 #include <vector>
+#include <utility>
 #include "stdcell.h"
+#include "connectivity.h"
+#include "hypergraph.h"
 
 struct module
 {
-    //Ordered list of gates as definitions only
-    std::vector<stdcell> gates;
+    //Ordered list of gate instances
+    std::vector<gate_instance> gates;
+
+    //Width and length of each gate, in the same order as `gates`
+    std::vector<float> widths;
+    std::vector<float> lengths;
     
-    //Connectivity matrix of the module gates
-    std::vector<std::vector<int>> connections;
+    //Sparse connectivity matrix of the module gates
+    connectivity connections;
+
+    //Nets of the module as hyperedges over the gates
+    hypergraph hyperedges;
     
     //Module name
     std::string name;
+
+    //Appends a gate along with its geometry
+    void addGate(const gate_instance& gate, float width, float length);
+};
+
+/* A part of a module, as the indices of its gates in the whole netlist. Views
+ * are cheap to pass around and split, as no gates or matrices are copied. The
+ * netlist is never changed through a view, and must outlive it */
+struct module_view
+{
+    const module* netlist;
+
+    //Indices into netlist->gates, never the I/O gates 0 and 1
+    std::vector<int> gates;
+
+    module_view() : netlist(nullptr) { }
+    module_view(const module* netlist, std::vector<int> gates)
+        : netlist(netlist), gates(std::move(gates)) { }
 };
 
+//A view of every gate of `m` but its I/O gates
+module_view viewModule(const module& m);
+
 
 /* roger
  * Loads and parses a .netblif file and returns a vector of all modules in the file,
  * with their connectivity matricies and standard cell gates.
- * Uses a MattCellFile to check and load standard cell information
+ * Uses a MattCellFile to check and load standard cell information.
+ * The file is memory mapped and tokenized in place unless `useMmap` is false,
+ * in which case it is read into a buffer first
  */
-std::vector<module> readModuleFile(const std::string& fileName, const MattCellFile& cells);
+std::vector<module> readModuleFile(const std::string& fileName, const MattCellFile& cells, bool useMmap = true);
+
+/* Same as readModuleFile, but the file is split on its .model/.end boundaries and
+ * each model is parsed and has its connectivity built on its own thread */
+std::vector<module> readModuleFileParallel(const std::string& fileName, const MattCellFile& cells, bool useMmap = true);
 
 #endif
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include "multilevel.h"
+#include "fiduccia.h"
+
+#define ML_COARSEST_GATES   100     //Graphs this small are partitioned directly
+#define ML_MIN_SHRINK       0.95    //Stop coarsening when a level keeps more than this of the gates
+#define ML_INITIAL_TRIES    8       //Number of partitions of the coarsest graph to pick the best of
+
+//Type definitions used in this file
+typedef std::vector<int> vint;
+
+/* Heavy-edge matching: visiting gates in a random order, each unmatched gate is
+ * merged with the unmatched neighbour it shares the heaviest connection with.
+ * Fills `merged` with the coarse gate of each gate and returns the coarse size */
+static int heavyEdgeMatching(const connectivity& matrix, const vint& weights, int maxWeight, vint& merged)
+{
+    int n = matrix.size();
+    vint order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::minstd_rand(n));
+
+    int size = 0;
+    merged.assign(n, -1);
+    for(int g : order) {
+        if(merged[g] != -1)
+            continue;
+        int best = -1, bestWeight = 0;
+        for(int e = matrix.rowStart[g]; e != matrix.rowStart[g+1]; ++e) {
+            int x = matrix.columns[e];
+            if(x != g && merged[x] == -1 && matrix.weights[e] > bestWeight &&
+               weights[g] + weights[x] <= maxWeight) {
+                best = x;
+                bestWeight = matrix.weights[e];
+            }
+        }
+        merged[g] = size;
+        if(best != -1)
+            merged[best] = size;
+        size += 1;
+    }
+    return size;
+}
+
+/* Weighted cut of a partition: connection weights across it, or cut nets on the
+ * hypergraph, and the pull of terminals on gates not on the side they pull to */
+static int cutSize(const connectivity& matrix, const hypergraph* nets, const vint& pull, const vint& side)
+{
+    int cut = 0;
+    if(nets) {
+        for(int e = 0; e != nets->numNets(); ++e) {
+            int first = nets->netStart[e];
+            for(int p = first + 1; p != nets->netStart[e+1]; ++p)
+                if(side[nets->pins[p]] != side[nets->pins[first]]) {
+                    cut += 1;
+                    break;
+                }
+        }
+    } else {
+        for(int g = 0; g != matrix.size(); ++g)
+            for(int e = matrix.rowStart[g]; e != matrix.rowStart[g+1]; ++e)
+                if(side[matrix.columns[e]] != side[g])
+                    cut += matrix.weights[e];
+        cut /= 2;
+    }
+    for(int g = 0; g != int(pull.size()); ++g)
+        cut += std::max(0, side[g] == 0 ? pull[g] : -pull[g]);
+    return cut;
+}
+
+static void refine(const connectivity& matrix, const hypergraph* nets, const vint& weights, const vint& pull,
+    vint& side, float balance)
+{
+    if(nets)
+        fiducciaMattheysesRefine(*nets, weights, side, balance, pull);
+    else
+        fiducciaMattheysesRefine(matrix, weights, side, balance, pull);
+}
+
+/* Grows side 0 breadth first from `seed` until it holds half of the weight. Gates
+ * not reachable from the seed are grown from in order if the half is not reached */
+static vint growPartition(const connectivity& matrix, const vint& weights, int seed)
+{
+    int n = matrix.size();
+    int half = std::accumulate(weights.begin(), weights.end(), 0) / 2;
+    vint side(n, 1), queue;
+    queue.reserve(n);
+
+    int grown = 0;
+    for(int next = 0; grown < half && next != n; ++next) {
+        int start = (seed + next) % n;
+        if(side[start] == 0)
+            continue;
+        side[start] = 0;
+        grown += weights[start];
+        queue.assign(1, start);
+        for(size_t q = 0; q != queue.size() && grown < half; ++q) {
+            int g = queue[q];
+            for(int e = matrix.rowStart[g]; e != matrix.rowStart[g+1] && grown < half; ++e) {
+                int x = matrix.columns[e];
+                if(side[x] == 1) {
+                    side[x] = 0;
+                    grown += weights[x];
+                    queue.push_back(x);
+                }
+            }
+        }
+    }
+    return side;
+}
+
+//Partitions the coarsest graph from several grown starts, keeping the smallest cut
+static void initialPartition(const connectivity& matrix, const hypergraph* nets, const vint& weights, const vint& pull,
+    vint& side, float balance)
+{
+    int n = matrix.size();
+    int bestCut = -1;
+    std::minstd_rand random(n);
+    for(int i = 0; i != ML_INITIAL_TRIES && n > 0; ++i) {
+        vint tried = growPartition(matrix, weights, random() % n);
+        refine(matrix, nets, weights, pull, tried, balance);
+        int cut = cutSize(matrix, nets, pull, tried);
+        if(bestCut == -1 || cut < bestCut) {
+            bestCut = cut;
+            side = std::move(tried);
+        }
+    }
+}
+
+//Coarsens one level, partitions the coarser graph recursively, and refines its projection
+static void multilevel(const connectivity& matrix, const hypergraph* nets, const vint& weights, const vint& pull,
+    vint& side, float balance)
+{
+    int n = matrix.size();
+    if(n <= ML_COARSEST_GATES) {
+        initialPartition(matrix, nets, weights, pull, side, balance);
+        return;
+    }
+
+    //No merged gate may grow past a fair share of the coarsest graph's weight
+    int total = std::accumulate(weights.begin(), weights.end(), 0);
+    int maxWeight = std::max(2, 3 * total / (2 * ML_COARSEST_GATES));
+    vint merged;
+    int size = heavyEdgeMatching(matrix, weights, maxWeight, merged);
+    if(size > n * ML_MIN_SHRINK) {
+        initialPartition(matrix, nets, weights, pull, side, balance);
+        return;
+    }
+
+    connectivity coarseMatrix = contractConnectivity(matrix, merged, size);
+    hypergraph coarseNets;
+    if(nets)
+        coarseNets = contractHypergraph(*nets, merged, size);
+    vint coarseWeights(size, 0), coarsePull(pull.empty() ? 0 : size, 0);
+    for(int g = 0; g != n; ++g)
+        coarseWeights[merged[g]] += weights[g];
+    for(int g = 0; g != int(pull.size()); ++g)
+        coarsePull[merged[g]] += pull[g];
+
+    vint coarseSide;
+    multilevel(coarseMatrix, nets ? &coarseNets : nullptr, coarseWeights, coarsePull, coarseSide, balance);
+
+    side.resize(n);
+    for(int g = 0; g != n; ++g)
+        side[g] = coarseSide[merged[g]];
+    refine(matrix, nets, weights, pull, side, balance);
+}
+
+static std::pair<vint,vint> multilevelSplit(const connectivity& matrix, const hypergraph* nets, const vint& weights,
+    float balance, const vint& pull)
+{
+    vint side;
+    multilevel(matrix, nets, weights.empty() ? vint(matrix.size(), 1) : weights, pull, side, balance);
+
+    std::pair<vint,vint> result;
+    for(int g = 0; g != int(side.size()); ++g)
+        (side[g] == 0 ? result.first : result.second).push_back(g);
+    return result;
+}
+
+/************************************************************************/
+
+std::pair<vint,vint> multilevelSolve(const connectivity& matrix, const vint& weights, float balance, const vint& pull)
+{
+    return multilevelSplit(matrix, nullptr, weights, balance, pull);
+}
+
+std::pair<vint,vint> multilevelSolve(const connectivity& matrix, const hypergraph& nets, const vint& weights,
+    float balance, const vint& pull)
+{
+    return multilevelSplit(matrix, &nets, weights, balance, pull);
+}
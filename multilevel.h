@@ -0,0 +1,23 @@
+#ifndef MULTILEVEL_H
+#define MULTILEVEL_H
+#include <vector>
+#include <utility>
+#include "connectivity.h"
+#include "hypergraph.h"
+
+/* Multilevel two-way partitioning, in the manner of hMETIS. The connectivity
+ * graph is coarsened by merging gates along their heaviest connections until it
+ * is small, the coarsest graph is partitioned, and the partition is projected
+ * back up one level at a time with FM refinement at each level.
+ * Input: The gate connections, and optionally the net hypergraph to refine the
+ *        cut nets on instead of the connection weights. The gate weights to
+ *        balance, or an empty vector to weigh every gate as 1. Optionally the pull
+ *        of fixed terminals on each gate, as for fiducciaMattheysesSolve
+ * Output: The gates of partition A and of partition B */
+
+std::pair<std::vector<int>,std::vector<int>> multilevelSolve(const connectivity& matrix,
+    const std::vector<int>& weights, float balance, const std::vector<int>& pull = std::vector<int>());
+std::pair<std::vector<int>,std::vector<int>> multilevelSolve(const connectivity& matrix, const hypergraph& nets,
+    const std::vector<int>& weights, float balance, const std::vector<int>& pull = std::vector<int>());
+
+#endif
@@ -0,0 +1,367 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <unordered_set>
+#include "utility.h"
+#include "nettable.h"
+#include "netcache.h"
+
+/* Snapshot header. The version changes whenever the layout of the snapshot does,
+ * or the way what it holds is built from the inputs, such as the connectivity */
+static const char     cacheMagic[8] = { 'V','L','S','I','N','E','T','C' };
+static const uint32_t cacheVersion  = 6;
+
+static const unsigned long long hashPrime = 0x9E3779B97F4A7C15ULL;
+
+//Hashes `length` bytes 8 at a time, so hashing runs near memory speed
+static unsigned long long hashBytes(const char* p, size_t length, unsigned long long hash)
+{
+    const unsigned long long prime = hashPrime;
+    hash = (hash ^ length) * prime;
+    for(; length >= 8; p += 8, length -= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    for(; length != 0; ++p, --length)
+        hash = (hash ^ static_cast<unsigned char>(*p)) * prime;
+    return hash;
+}
+
+/* Hashes a file's contents. A file that does not open, such as the name of a
+ * compiled in library, is keyed by its name instead */
+static unsigned long long hashFile(const std::string& fileName, unsigned long long hash)
+{
+    MappedFile file(fileName);
+    if(!file.isOpen())
+        return hashBytes(fileName.data(), fileName.size(), hash * hashPrime);
+    return hashBytes(file.begin(), file.end() - file.begin(), hash);
+}
+
+//Hashes a cell library compiled into the program, entry by entry
+static unsigned long long hashCells(const stdcell_definition* table, size_t count, unsigned long long hash)
+{
+    hash = (hash ^ count) * hashPrime;
+    for(size_t i = 0; i != count; ++i) {
+        const stdcell_definition& cell = table[i];
+        hash = hashBytes(cell.name, std::strlen(cell.name), hash);
+        hash = hashBytes(reinterpret_cast<const char*>(&cell.width), sizeof(cell.width), hash);
+        hash = hashBytes(reinterpret_cast<const char*>(&cell.length), sizeof(cell.length), hash);
+        hash = hashBytes(cell.pins, std::strlen(cell.pins), hash);
+    }
+    return hash;
+}
+
+/******************************************************************/
+
+template<typename T>
+static void writeValue(std::ostream& os, const T& value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static void writeVector(std::ostream& os, const std::vector<T>& v)
+{
+    writeValue(os, uint32_t(v.size()));
+    os.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+}
+
+static void writeString(std::ostream& os, const std::string& s)
+{
+    writeValue(os, uint32_t(s.size()));
+    os.write(s.data(), s.size());
+}
+
+static void writeCell(std::ostream& os, const stdcell& cell)
+{
+    writeString(os, cell.name);
+    writeValue(os, cell.width);
+    writeValue(os, cell.length);
+    writeVector(os, cell.inputs);
+    writeVector(os, cell.outputs);
+}
+
+static void writeGate(std::ostream& os, const gate_instance& gate)
+{
+    writeValue(os, gate.cell);
+    writeVector(os, gate.inputs);
+    writeVector(os, gate.outputs);
+}
+
+//Reads values back out of a mapped snapshot. `ok` becomes false if the snapshot is cut short
+struct CacheReader
+{
+    const char* pos;
+    const char* end;
+    bool ok = true;
+
+    CacheReader(const char* begin, const char* end) : pos(begin), end(end) { }
+
+    bool take(void* dest, size_t size)
+    {
+        if(!ok || size_t(end - pos) < size)
+            return ok = false;
+        if(size != 0)
+            std::memcpy(dest, pos, size);
+        pos += size;
+        return true;
+    }
+
+    template<typename T>
+    T value()
+    {
+        T v = T();
+        take(&v, sizeof(T));
+        return v;
+    }
+
+    /* Reads a count of items that each take at least `minSize` bytes of the snapshot,
+     * so a corrupt count fails here instead of allocating more than could be read */
+    uint32_t count(size_t minSize)
+    {
+        uint32_t n = value<uint32_t>();
+        if(!ok || size_t(end - pos) / minSize < n) {
+            ok = false;
+            return 0;
+        }
+        return n;
+    }
+
+    template<typename T>
+    void vector(std::vector<T>& v)
+    {
+        uint32_t size = value<uint32_t>();
+        if(!ok || size_t(end - pos) / sizeof(T) < size) {
+            ok = false;
+            return;
+        }
+        v.resize(size);
+        take(v.data(), size * sizeof(T));
+    }
+
+    std::string string()
+    {
+        uint32_t size = value<uint32_t>();
+        if(!ok || size_t(end - pos) < size) {
+            ok = false;
+            return std::string();
+        }
+        std::string s(pos, size);
+        pos += size;
+        return s;
+    }
+
+    void cell(stdcell& c)
+    {
+        c.name   = string();
+        c.width  = value<float>();
+        c.length = value<float>();
+        vector(c.inputs);
+        vector(c.outputs);
+    }
+
+    void gate(gate_instance& g)
+    {
+        g.cell = value<int>();
+        vector(g.inputs);
+        vector(g.outputs);
+    }
+};
+
+//Whether `starts` rises from 0 to `total` without ever going back
+static bool validOffsets(const std::vector<int>& starts, size_t total)
+{
+    return !starts.empty() && starts.front() == 0 && starts.back() == int(total) &&
+        std::is_sorted(starts.begin(), starts.end());
+}
+
+//Whether every entry of `v` is in [0, limit)
+static bool allBelow(const std::vector<int>& v, int limit)
+{
+    return std::all_of(v.begin(), v.end(), [limit](int x) { return x >= 0 && x < limit; });
+}
+
+/******************************************************************/
+
+NetlistCache::NetlistCache(const std::string& cellFile, const std::string& moduleFile,
+    const stdcell_definition* builtinCells, size_t builtinCount)
+    : cacheName(moduleFile + ".cache")
+{
+    inputHash = hashFile(cellFile, cacheVersion);
+    if(builtinCells != nullptr)
+        inputHash = hashCells(builtinCells, builtinCount, inputHash);
+    inputHash = hashFile(moduleFile, inputHash);
+}
+
+bool NetlistCache::load(std::vector<stdcell>& cells, std::vector<module>& modules) const
+{
+    MappedFile file(cacheName);
+    if(!file.isOpen())
+        return false;
+
+    //Check the header is for this version and these inputs
+    CacheReader in(file.begin(), file.end());
+    char magic[sizeof(cacheMagic)];
+    in.take(magic, sizeof(magic));
+    uint32_t version = in.value<uint32_t>();
+    unsigned long long hash = in.value<unsigned long long>();
+    if(!in.ok || std::memcmp(magic, cacheMagic, sizeof(magic)) != 0 || version != cacheVersion || hash != inputHash)
+        return false;
+
+    //Net names are only interned once the whole snapshot has been checked
+    uint32_t nNames = in.count(sizeof(uint32_t));
+    std::vector<string_ref> names;
+    for(uint32_t i = 0; i != nNames && in.ok; ++i) {
+        uint32_t size = in.value<uint32_t>();
+        if(!in.ok || size_t(in.end - in.pos) < size)
+            return false;
+        names.push_back(string_ref(in.pos, size));
+        in.pos += size;
+    }
+
+    //Counts are checked against the smallest a cell, module or gate can be written in
+    std::vector<stdcell> cachedCells(in.count(3*sizeof(uint32_t) + 2*sizeof(float)));
+    for(stdcell& cell : cachedCells)
+        in.cell(cell);
+
+    std::vector<module> cachedModules(in.count(11*sizeof(uint32_t)));
+    for(module& m : cachedModules) {
+        m.name = in.string();
+        m.gates.resize(in.count(sizeof(int) + 2*sizeof(uint32_t)));
+        for(gate_instance& gate : m.gates)
+            in.gate(gate);
+        in.vector(m.widths);
+        in.vector(m.lengths);
+        in.vector(m.connections.rowStart);
+        in.vector(m.connections.columns);
+        in.vector(m.connections.weights);
+        in.vector(m.hyperedges.netStart);
+        in.vector(m.hyperedges.pins);
+        in.vector(m.hyperedges.gateStart);
+        in.vector(m.hyperedges.gateNets);
+        if(!in.ok)
+            return false;
+    }
+    if(!in.ok)
+        return false;
+
+    /* Check every net ID, offset and gate, cell or net index is in range before using
+     * them, so a corrupt snapshot is parsed again instead of read out of bounds. Cell
+     * names must be unique, so the cells keep their indices in the rebuilt library */
+    auto validNet = [&](netid n) { return n >= 0 && n < netid(nNames); };
+    auto validCell = [&](const stdcell& cell) {
+        return std::all_of(cell.inputs.begin(), cell.inputs.end(), validNet) &&
+               std::all_of(cell.outputs.begin(), cell.outputs.end(), validNet);
+    };
+    auto validGate = [&](const gate_instance& gate) {
+        bool validIndex = gate.cell == CELL_INPUTS || gate.cell == CELL_OUTPUTS ||
+            (gate.cell >= 0 && gate.cell < int(cachedCells.size()));
+        return validIndex &&
+               std::all_of(gate.inputs.begin(), gate.inputs.end(), validNet) &&
+               std::all_of(gate.outputs.begin(), gate.outputs.end(), validNet);
+    };
+    std::unordered_set<std::string> cellNames;
+    for(const stdcell& cell : cachedCells)
+        if(!validCell(cell) || !cellNames.insert(cell.name).second)
+            return false;
+    for(const module& m : cachedModules) {
+        int nGates = m.gates.size();
+        if(m.widths.size() != m.gates.size() || m.lengths.size() != m.gates.size())
+            return false;
+        const connectivity& c = m.connections;
+        if(c.rowStart.size() != m.gates.size() + 1 || c.columns.size() != c.weights.size() ||
+           !validOffsets(c.rowStart, c.columns.size()) || !allBelow(c.columns, nGates))
+            return false;
+        const hypergraph& h = m.hyperedges;
+        if(h.gateStart.size() != m.gates.size() + 1 || !validOffsets(h.gateStart, h.gateNets.size()) ||
+           !validOffsets(h.netStart, h.pins.size()) || !allBelow(h.pins, nGates) ||
+           !allBelow(h.gateNets, h.numNets()))
+            return false;
+        for(const gate_instance& gate : m.gates)
+            if(!validGate(gate))
+                return false;
+    }
+
+    /* Net names are interned again. IDs stay the same when the net table is
+     * empty, otherwise the cached IDs are remapped to the current table's */
+    std::vector<netid> remap;
+    bool identity = true;
+    for(uint32_t i = 0; i != nNames; ++i) {
+        remap.push_back(nets().intern(names[i]));
+        identity = identity && (remap.back() == netid(i));
+    }
+
+    //Remap net IDs if the table already had other names in it
+    auto remapNets = [&](std::vector<netid>& v) {
+        for(netid& n : v)
+            n = remap[n];
+    };
+    if(!identity) {
+        for(stdcell& cell : cachedCells) {
+            remapNets(cell.inputs);
+            remapNets(cell.outputs);
+        }
+        for(module& m : cachedModules)
+            for(gate_instance& gate : m.gates) {
+                remapNets(gate.inputs);
+                remapNets(gate.outputs);
+            }
+    }
+
+    cells = std::move(cachedCells);
+    modules = std::move(cachedModules);
+    return true;
+}
+
+void NetlistCache::save(const MattCellFile& cells, const std::vector<module>& modules) const
+{
+    /* Write to a uniquely named file and rename it over the cache, so runs started
+     * at the same time never see a partly written snapshot. The cache is only an
+     * optimization, so failing to write it is not an error */
+    std::stringstream tmpName;
+    tmpName << cacheName << ".tmp" << std::random_device()();
+    std::ofstream os(tmpName.str(), std::ios::binary);
+    if(!os.is_open())
+        return;
+
+    os.write(cacheMagic, sizeof(cacheMagic));
+    writeValue(os, cacheVersion);
+    writeValue(os, inputHash);
+
+    uint32_t nNames = nets().size();
+    writeValue(os, nNames);
+    for(uint32_t i = 0; i != nNames; ++i)
+        writeString(os, nets().name(i));
+
+    std::vector<stdcell> definitions = cells.definitions();
+    writeValue(os, uint32_t(definitions.size()));
+    for(const stdcell& cell : definitions)
+        writeCell(os, cell);
+
+    writeValue(os, uint32_t(modules.size()));
+    for(const module& m : modules) {
+        writeString(os, m.name);
+        writeValue(os, uint32_t(m.gates.size()));
+        for(const gate_instance& gate : m.gates)
+            writeGate(os, gate);
+        writeVector(os, m.widths);
+        writeVector(os, m.lengths);
+        writeVector(os, m.connections.rowStart);
+        writeVector(os, m.connections.columns);
+        writeVector(os, m.connections.weights);
+        writeVector(os, m.hyperedges.netStart);
+        writeVector(os, m.hyperedges.pins);
+        writeVector(os, m.hyperedges.gateStart);
+        writeVector(os, m.hyperedges.gateNets);
+    }
+
+    os.close();
+    if(!os || std::rename(tmpName.str().c_str(), cacheName.c_str()) != 0)
+        std::remove(tmpName.str().c_str());
+}
@@ -0,0 +1,35 @@
+#ifndef NET_CACHE_H
+#define NET_CACHE_H
+#include <string>
+#include <vector>
+#include "module.h"
+#include "stdcell.h"
+
+/* NetlistCache is a binary snapshot of a parsed standard cell library and
+ * module file, stored next to the module file as "<module file>.cache".
+ * The snapshot is keyed by a hash of both input files' contents, so it is
+ * only used while neither file has changed. Loading is a single mmap of the
+ * snapshot, with no tokenizing or connectivity building. */
+
+class NetlistCache
+{
+public:
+    /* Hashes the contents of the input files the cache is for. When the cells
+     * are a library compiled into the program, its table is hashed as well */
+    NetlistCache(const std::string& cellFile, const std::string& moduleFile,
+        const stdcell_definition* builtinCells = nullptr, size_t builtinCount = 0);
+
+    /* Loads the cell definitions and modules from the cache. Returns false,
+     * leaving the outputs unchanged, if there is no cache for the current
+     * input files' contents */
+    bool load(std::vector<stdcell>& cells, std::vector<module>& modules) const;
+
+    //Writes a snapshot of the cells and modules for the current input files
+    void save(const MattCellFile& cells, const std::vector<module>& modules) const;
+
+private:
+    std::string cacheName;
+    unsigned long long inputHash;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "nettable.h"
+
+#define NT_SHARDS       64          //Number of independently locked parts of the table
+#define NT_BLOCK_BITS   12          //Names per storage block, as a power of two
+#define NT_MAX_BLOCKS   (1 << 16)   //Most storage blocks, which caps the table at 2^28 names
+
+NetTable::NetTable()
+    : shards(new shard[NT_SHARDS])
+    , blocks(new std::atomic<std::string*>[NT_MAX_BLOCKS])
+    , count(0)
+{
+    for(int b = 0; b != NT_MAX_BLOCKS; ++b)
+        blocks[b] = nullptr;
+}
+
+NetTable::~NetTable()
+{
+    for(int b = 0; b != NT_MAX_BLOCKS; ++b)
+        delete[] blocks[b].load();
+}
+
+NetTable::shard& NetTable::shardOf(const string_ref& name) const
+{
+    size_t h = string_ref_hash()(name);
+    return shards[(h ^ (h >> 17)) % NT_SHARDS];
+}
+
+//Storage for the name of `id`, allocating its block the first time it is reached
+std::string& NetTable::slot(netid id)
+{
+    int b = id >> NT_BLOCK_BITS;
+    if(b >= NT_MAX_BLOCKS)
+        error("Too many net names: ", id);
+    std::string* block = blocks[b].load(std::memory_order_acquire);
+    if(block == nullptr) {
+        std::lock_guard<std::mutex> guard(blockLock);
+        block = blocks[b].load(std::memory_order_acquire);
+        if(block == nullptr) {
+            block = new std::string[1 << NT_BLOCK_BITS];
+            blocks[b].store(block, std::memory_order_release);
+        }
+    }
+    return block[id & ((1 << NT_BLOCK_BITS) - 1)];
+}
+
+netid NetTable::intern(const string_ref& name)
+{
+    shard& s = shardOf(name);
+    std::lock_guard<std::mutex> guard(s.lock);
+    auto it = s.ids.find(name);
+    if(it != s.ids.end())
+        return it->second;
+
+    //The key must point at the stored copy, not the caller's characters
+    netid id = count.fetch_add(1);
+    std::string& stored = slot(id);
+    stored = name.str();
+    s.ids.emplace(string_ref(stored.data(), stored.size()), id);
+    return id;
+}
+
+netid NetTable::find(const string_ref& name) const
+{
+    shard& s = shardOf(name);
+    std::lock_guard<std::mutex> guard(s.lock);
+    auto it = s.ids.find(name);
+    return (it != s.ids.end()) ? it->second : -1;
+}
+
+/* IDs are only handed out once their name is stored, under their shard's lock, so
+ * a thread holding an ID always sees its name and block */
+const std::string& NetTable::name(netid id) const
+{
+    if(id < 0 || id >= count.load())
+        throw std::out_of_range("NetTable::name");
+    const std::string* block = blocks[id >> NT_BLOCK_BITS].load(std::memory_order_acquire);
+    return block[id & ((1 << NT_BLOCK_BITS) - 1)];
+}
+
+int NetTable::size() const
+{
+    return count.load();
+}
+
+NetTable& nets()
+{
+    static NetTable table;
+    return table;
+}
+
+std::vector<std::string> netNames(const std::vector<netid>& ids)
+{
+    std::vector<std::string> result;
+    for(netid id : ids)
+        result.push_back(nets().name(id));
+    return result;
+}
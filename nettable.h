@@ -0,0 +1,70 @@
+#ifndef NET_TABLE_H
+#define NET_TABLE_H
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "utility.h"
+
+//Integer ID of an interned net name
+typedef int netid;
+
+/* NetTable interns net names, so every name is stored once and gates refer
+ * to their nets by compact integer IDs. Standard cell pin names are interned
+ * in the same table. IDs are only turned back into names for output.
+ * All member functions are safe to call from multiple threads. Names are spread
+ * over shards by hash, each with its own lock, so threads parsing different models
+ * rarely wait on each other. Names are stored in fixed blocks that never move, so
+ * looking up a name by ID takes no lock */
+
+class NetTable
+{
+public:
+    NetTable();
+    ~NetTable();
+
+    //Returns the ID of `name`, adding it to the table if it is new
+    netid intern(const string_ref& name);
+
+    //Returns the ID of `name`, or -1 if it has never been interned
+    netid find(const string_ref& name) const;
+
+    //Returns the name of net `id`
+    const std::string& name(netid id) const;
+
+    //Number of names in the table, including any still being added by other threads
+    int size() const;
+
+private:
+    struct shard
+    {
+        std::unordered_map<string_ref, netid, string_ref_hash> ids;  //Keys point into the name blocks
+        std::mutex lock;
+    };
+
+    std::unique_ptr<shard[]> shards;
+    std::unique_ptr<std::atomic<std::string*>[]> blocks;    //Names of IDs [b*block size, (b+1)*block size)
+    std::atomic<int> count;
+    std::mutex blockLock;                                   //Taken only to allocate a block
+
+    shard& shardOf(const string_ref& name) const;
+    std::string& slot(netid id);
+};
+
+//The table shared by all modules and standard cell files
+NetTable& nets();
+
+//Looks up the names of a list of nets, for output
+std::vector<std::string> netNames(const std::vector<netid>& ids);
+
+/* Orders nets by name. IDs follow the order names were interned in, which depends
+ * on thread timing when models are parsed in parallel, so anything ordered for
+ * output is ordered by name instead */
+struct netNameLess
+{
+    bool operator()(netid a, netid b) const { return nets().name(a) < nets().name(b); }
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <iomanip>
 #include <fstream>
 #include <algorithm>
+#include <unordered_set>
 #include "utility.h"
 #include "output.h"
 
@@ -18,26 +19,32 @@ void getSubcktWireLines(const module& partition,
     if(!outputs.empty()) outputLine = ".OUT";
 
     //Copy the module's inputs/outputs to the .IN and .OUT lines
-    for(const std::string& item :  inputs)
-         inputLine.append(" ").append(item).append(",");
-    for(const std::string& item : outputs)
-        outputLine.append(" ").append(item).append(",");
+    for(netid item :  inputs)
+         inputLine.append(" ").append(nets().name(item)).append(",");
+    for(netid item : outputs)
+        outputLine.append(" ").append(nets().name(item)).append(",");
     
     /* We look though each gate's inputs and outputs. If they do not tie to the
      * module's inputs or outputs, they are wires that connect to other gates,
-     * and are added to the .WIRE line if they are not there already */
+     * and are added to the .WIRE line if they are not there already. Wires are
+     * written in the order the gates first use them; `seen` only tells if a
+     * wire was already added */
+    std::vector<netid> wires;
+    std::unordered_set<netid> seen;
     auto tryAddToWireLine =
-    [&](const std::string& pin, const std::vector<std::string>& io) {
-        if((std::find(io.begin(), io.end(), pin) == io.end()) && (wireLine.find(pin) == std::string::npos))
-            wireLine.append(" ").append(pin).append(",");
+    [&](netid pin, const std::vector<netid>& io) {
+        if((std::find(io.begin(), io.end(), pin) == io.end()) && seen.insert(pin).second)
+            wires.push_back(pin);
     };
 
     for(unsigned i = 2; i < partition.gates.size(); ++i) {
-        for(const std::string& pin : partition.gates[i].inputs)
+        for(netid pin : partition.gates[i].inputs)
             tryAddToWireLine(pin, inputs);
-        for(const std::string& pin : partition.gates[i].outputs)
+        for(netid pin : partition.gates[i].outputs)
             tryAddToWireLine(pin, outputs);
     }
+    for(netid wire : wires)
+        wireLine.append(" ").append(nets().name(wire)).append(",");
     
     //Removing last commas on the strings.
     //And if wires is not empty, it needs .WIRE inserted
@@ -54,25 +61,25 @@ void getSubcktWireLines(const module& partition,
 }
 
 
-std::string getSubcktGateLine(const stdcell& gate, const MattCellFile& cells, int count)
+std::string getSubcktGateLine(const gate_instance& gate, const MattCellFile& cells, int count)
 {
     char buffer[64];
     std::stringstream ss;
 
     //Write gate name. ex: "x0 nand2"
-    std::sprintf(buffer, "x%-3d %-6s ", count, gate.name.c_str());
+    std::sprintf(buffer, "x%-3d %-6s ", count, cells.name(gate.cell).c_str());
     ss << buffer;
     
     //To get standard information (the A part below)
-    const stdcell& cell = cells[gate.name];
+    const stdcell& cell = cells.at(gate.cell);
 
     //Give a ".A(B)" string for each input/output and its attachment. Bad duplicated code.
     for(unsigned i = 0; i != gate.inputs.size(); ++i) {
-        std::sprintf(buffer, ".%s(%s)", cell.inputs[i].c_str(), gate.inputs[i].c_str());
+        std::sprintf(buffer, ".%s(%s)", nets().name(cell.inputs[i]).c_str(), nets().name(gate.inputs[i]).c_str());
         ss << std::left << std::setw(12) << buffer;
     }
     for(unsigned i = 0; i != gate.outputs.size(); ++i) {
-        std::sprintf(buffer, ".%s(%s)", cell.outputs[i].c_str(), gate.outputs[i].c_str());
+        std::sprintf(buffer, ".%s(%s)", nets().name(cell.outputs[i]).c_str(), nets().name(gate.outputs[i]).c_str());
         ss << std::left << std::setw(12) << buffer;
     }
 
@@ -108,8 +115,8 @@ std::string getSubcktTextSingle(const module& partition, const MattCellFile& cel
     ss << buffer;
 
     //The [Inputs] [Outputs] text after name
-    for(const std::string& s : partition.gates[0].outputs)  ss << " " << s << ".I";
-    for(const std::string& s : partition.gates[1].inputs)   ss << " " << s << ".O";
+    for(netid s : partition.gates[0].outputs)  ss << " " << nets().name(s) << ".I";
+    for(netid s : partition.gates[1].inputs)   ss << " " << nets().name(s) << ".O";
     ss << '\n';
 
     //.IN, .OUT, and .WIRE lines
@@ -137,16 +144,17 @@ std::string getSubcktText(const std::pair<module,module>& p, const MattCellFile
 
 int getExternWireCost(const module& a, const module& b)
 {
-    std::vector<std::string> wires;
+    std::vector<netid> wires;
     const auto& ins0  = a.gates[0].outputs;
     const auto& ins1  = b.gates[0].outputs;
     const auto& outs0 = a.gates[1].inputs;
     const auto& outs1 = b.gates[1].inputs;
 
     //External wire cost is easily determined as intersection between
-    //the inputs and outputs across modules
-    std::set_intersection(ins0.begin(), ins0.end(), outs1.begin(), outs1.end(), std::back_inserter(wires));
-    std::set_intersection(ins1.begin(), ins1.end(), outs0.begin(), outs0.end(), std::back_inserter(wires));
+    //the inputs and outputs across modules, which are sorted by name
+    netNameLess byName;
+    std::set_intersection(ins0.begin(), ins0.end(), outs1.begin(), outs1.end(), std::back_inserter(wires), byName);
+    std::set_intersection(ins1.begin(), ins1.end(), outs0.begin(), outs0.end(), std::back_inserter(wires), byName);
 
     //`wires` now contains all external wiring between a and b
     return wires.size();
@@ -193,7 +201,8 @@ std::ostream& SubcktFile::operator<<(const std::pair<module,module>& partitions)
 /****************************************************************************/
 /****************************************************************************/
 
-UnityFile::UnityFile(const std::string &filename)
+UnityFile::UnityFile(const std::string &filename, const MattCellFile& cells)
+    : cellsRef(cells)
 {
     file.open(filename, std::ios::out);
     if(!file.is_open()) {
@@ -201,20 +210,22 @@ UnityFile::UnityFile(const std::string &filename)
     }
 }
 
-void UnityFile::write(std::vector<module>& modules, std::vector<polish_string>& polishes)
+void UnityFile::write(const std::vector<module_view>& partitions, const std::vector<polish_string>& polishes)
 {
-    if(modules.size() != polishes.size())
+    if(partitions.size() != polishes.size())
         error("UnityFile modules and polish sizes differ");
 
     int i = 0;
-    for(const module& m : modules)
+    for(const module_view& part : partitions)
     {
+        const module& m = *part.netlist;
         file << "slice" << i << std::endl;
 
         //Write gate widths/lengths
-        for(unsigned j = 2; j < m.gates.size(); ++j) {
-            const stdcell& gate = m.gates[j];
-            file << j-2 << " " << gate.name << " " << gate.width << " " << gate.length << std::endl;
+        for(unsigned j = 0; j < part.gates.size(); ++j) {
+            int g = part.gates[j];
+            file << j << " " << cellsRef.name(m.gates[g].cell) << " "
+                 << m.widths[g] << " " << m.lengths[g] << std::endl;
         }
 
         //Write polish string
@@ -35,13 +35,14 @@ private:
 class UnityFile
 {
 public:
-    UnityFile(const std::string& filename);
+    UnityFile(const std::string& filename, const MattCellFile& cells);
 
     //Writes all partitioned modules along with their polishes
-    void write(std::vector<module>& modules, std::vector<polish_string>& polishes);
+    void write(const std::vector<module_view>& partitions, const std::vector<polish_string>& polishes);
 
 private:
     std::ofstream file;
+    const MattCellFile& cellsRef;
 };
 
 #endif
@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "slicing_tree.h"
+
+//Type definitions used in this file
+typedef std::vector<int> vint;
+
+//Sizes a leaf to its gate and records where the gate's leaf is
+void SlicingTree::setLeaf(const vint& polish, int node)
+{
+    int gate = polish[node];
+    leaf[gate] = node;
+    left[node] = -1;
+    right[node] = -1;
+    w[node] = m->lengths[gate+2];
+    h[node] = m->widths[gate+2];
+}
+
+/* Builds the tree bottom-up, sizing each node as it is closed. Each operator takes
+ * the two nodes on top of the stack, the older one as its left child */
+bool SlicingTree::build(const vint& polish)
+{
+    int n = polish.size();
+    int nGates = int(m->gates.size()) - 2;
+    left.assign(n, -1);
+    right.assign(n, -1);
+    parent.assign(n, -1);
+    w.resize(n);
+    h.resize(n);
+    leaf.assign(std::max(nGates, 0), -1);
+    stack.clear();
+
+    for(int i = 0; i != n; ++i) {
+        int token = polish[i];
+        if(token >= 0) {
+            if(token >= nGates || leaf[token] != -1)
+                return false;
+            setLeaf(polish, i);
+            stack.push_back(i);
+            continue;
+        }
+
+        if(stack.size() < 2)
+            return false;
+        int r = stack.back(); stack.pop_back();
+        int l = stack.back(); stack.pop_back();
+        left[i] = l;
+        right[i] = r;
+        parent[l] = i;
+        parent[r] = i;
+        if(token == POLISH_H) {
+            w[i] = w[l] + w[r];
+            h[i] = std::max(h[l], h[r]);
+        } else {
+            w[i] = std::max(w[l], w[r]);
+            h[i] = h[l] + h[r];
+        }
+        stack.push_back(i);
+    }
+
+    //A valid expression leaves only the root, and places every gate
+    return stack.size() == 1 && n == 2*nGates - 1;
+}
+
+/* Resizes `node` and its ancestors, until a size comes out the same as before.
+ * The path up to the root is marked to be placed again either way, stopping at
+ * a node an earlier call already marked and left the same size */
+void SlicingTree::resizeUp(const vint& polish, int node)
+{
+    bool resizing = true;
+    for(; node != -1 && (resizing || !dirty[node]); node = parent[node]) {
+        int l = left[node], r = right[node];
+        if(resizing && l != -1) {
+            float nw = (polish[node] == POLISH_H) ? w[l] + w[r] : std::max(w[l], w[r]);
+            float nh = (polish[node] == POLISH_H) ? std::max(h[l], h[r]) : h[l] + h[r];
+            resizing = (nw != w[node] || nh != h[node]);
+            w[node] = nw;
+            h[node] = nh;
+        }
+        dirty[node] = 1;
+    }
+}
+
+/* Places the nodes top-down from the root at (0, 0). A subtree that was not
+ * changed and is still at the same corner has not moved, and is skipped. With
+ * `track`, gates whose center changed are listed in `moved` */
+void SlicingTree::place(const vint& polish, bool track)
+{
+    toPlace.clear();
+    toPlace.push_back(pending{ int(polish.size()) - 1, 0, 0 });
+    while(!toPlace.empty()) {
+        pending p = toPlace.back();
+        toPlace.pop_back();
+        int i = p.node;
+        if(!dirty[i] && x[i] == p.x && y[i] == p.y)
+            continue;
+        dirty[i] = 0;
+        x[i] = p.x;
+        y[i] = p.y;
+
+        int l = left[i], r = right[i];
+        if(l != -1) {
+            bool across = (polish[i] == POLISH_H);
+            toPlace.push_back(pending{ l, p.x, p.y });
+            toPlace.push_back(pending{ r, across ? p.x + w[l] : p.x, across ? p.y : p.y + h[l] });
+            continue;
+        }
+
+        int gate = polish[i];
+        float nx = p.x + w[i]/2, ny = p.y + h[i]/2;
+        if(nx == cx[gate] && ny == cy[gate])
+            continue;
+        if(track && !isMoved[gate]) {
+            isMoved[gate] = 1;
+            oldX[gate] = cx[gate];
+            oldY[gate] = cy[gate];
+            moved.push_back(gate);
+        }
+        cx[gate] = nx;
+        cy[gate] = ny;
+    }
+}
+
+//Pins on the module's I/O gates have no place in the floorplan, and are left out
+double SlicingTree::netHalfPerimeter(int net) const
+{
+    const hypergraph& nets = m->hyperedges;
+    float x0 = 0, x1 = 0, y0 = 0, y1 = 0;
+    bool first = true;
+    for(int p = nets.netStart[net]; p != nets.netStart[net+1]; ++p) {
+        int g = nets.pins[p] - 2;
+        if(g < 0)
+            continue;
+        x0 = first ? cx[g] : std::min(x0, cx[g]);
+        x1 = first ? cx[g] : std::max(x1, cx[g]);
+        y0 = first ? cy[g] : std::min(y0, cy[g]);
+        y1 = first ? cy[g] : std::max(y1, cy[g]);
+        first = false;
+    }
+    return (x1 - x0) + (y1 - y0);
+}
+
+//Measures all wires. Each connection is counted once, from its lower numbered gate
+void SlicingTree::measure()
+{
+    length = 0;
+    if(metric == WireMetric::HalfPerimeter) {
+        netLength.resize(m->hyperedges.numNets());
+        for(int e = 0; e != m->hyperedges.numNets(); ++e) {
+            netLength[e] = netHalfPerimeter(e);
+            length += netLength[e];
+        }
+        return;
+    }
+
+    const connectivity& conns = m->connections;
+    for(int g = 2; g < conns.size(); ++g) {
+        for(int e = conns.rowStart[g]; e != conns.rowStart[g+1]; ++e) {
+            int other = conns.columns[e];
+            if(other <= g)
+                continue;
+            float d = std::fabs(cx[g-2] - cx[other-2]) + std::fabs(cy[g-2] - cy[other-2]);
+            length += double(d) * conns.weights[e];
+        }
+    }
+}
+
+/* Measures again only the wires of the gates in `moved`. A connection between two
+ * moved gates is counted once, from its lower numbered gate */
+void SlicingTree::remeasureMoved()
+{
+    if(metric == WireMetric::HalfPerimeter) {
+        const hypergraph& nets = m->hyperedges;
+        for(int g : moved) {
+            for(int i = nets.gateStart[g+2]; i != nets.gateStart[g+3]; ++i) {
+                int e = nets.gateNets[i];
+                if(!isTouched[e]) {
+                    isTouched[e] = 1;
+                    touched.push_back(e);
+                }
+            }
+        }
+        for(int e : touched) {
+            double newLength = netHalfPerimeter(e);
+            length += newLength - netLength[e];
+            netLength[e] = newLength;
+            isTouched[e] = 0;
+        }
+        touched.clear();
+    } else {
+        const connectivity& conns = m->connections;
+        for(int g : moved) {
+            for(int e = conns.rowStart[g+2]; e != conns.rowStart[g+3]; ++e) {
+                int other = conns.columns[e] - 2;
+                if(other < 0 || other == g || (isMoved[other] && other < g))
+                    continue;
+                float ox = isMoved[other] ? oldX[other] : cx[other];
+                float oy = isMoved[other] ? oldY[other] : cy[other];
+                float before = std::fabs(oldX[g] - ox) + std::fabs(oldY[g] - oy);
+                float after  = std::fabs(cx[g] - cx[other]) + std::fabs(cy[g] - cy[other]);
+                length += (double(after) - before) * conns.weights[e];
+            }
+        }
+    }
+
+    for(int g : moved)
+        isMoved[g] = 0;
+    moved.clear();
+}
+
+//Takes the cost from the root's size and the wire length
+void SlicingTree::finish()
+{
+    int root = left.size() - 1;
+    result.area = std::lround(double(w[root]) * h[root]);
+    result.wirelength = std::lround(length);
+}
+
+int SlicingTree::firstLeaf(int node) const
+{
+    while(left[node] != -1)
+        node = left[node];
+    return node;
+}
+
+//Points the child of `parentNode` that was `from` at `to` instead
+void SlicingTree::relink(int parentNode, int from, int to)
+{
+    (left[parentNode] == from ? left[parentNode] : right[parentNode]) = to;
+    parent[to] = parentNode;
+}
+
+/************************************************************************/
+
+bool SlicingTree::evaluate(const vint& polish, const module& m, WireMetric metric)
+{
+    this->m = &m;
+    this->metric = metric;
+    result = slicing_cost();
+    isValid = false;
+    if(polish.empty())
+        return isValid = (m.gates.size() <= 2);
+    if(!build(polish))
+        return false;
+
+    int n = polish.size(), nGates = leaf.size();
+    x.assign(n, 0);
+    y.assign(n, 0);
+    dirty.assign(n, 1);
+    cx.assign(nGates, 0);
+    cy.assign(nGates, 0);
+    place(polish, false);
+    measure();
+
+    moved.clear();
+    isMoved.assign(nGates, 0);
+    oldX.resize(nGates);
+    oldY.resize(nGates);
+    touched.clear();
+    isTouched.assign(netLength.size(), 0);
+
+    finish();
+    return isValid = true;
+}
+
+bool SlicingTree::swapLeaves(const vint& polish, int i, int j)
+{
+    if(!isValid || polish.empty())
+        return false;
+    setLeaf(polish, i);
+    setLeaf(polish, j);
+    resizeUp(polish, i);
+    resizeUp(polish, j);
+    place(polish, true);
+    remeasureMoved();
+    finish();
+    return true;
+}
+
+bool SlicingTree::complementOperators(const vint& polish, int first, int last)
+{
+    if(!isValid || polish.empty())
+        return false;
+    for(int i = first; i < last; ++i)
+        resizeUp(polish, i);
+    place(polish, true);
+    remeasureMoved();
+    finish();
+    return true;
+}
+
+/* Swapping an operand and an operator next to each other only relinks the nodes
+ * around them. The stack holds as many subtrees after the pair as before, so the
+ * operators that took each of them take its replacement:
+ *   X b op -> Y X op b: the operator now joins Y and X, and b takes its place
+ *   Y X op b -> X b op: the operator now joins X and b, and Y takes its place */
+bool SlicingTree::swapOperandOperator(const vint& polish, int i, int j)
+{
+    if(!isValid || polish.empty())
+        return false;
+    int a = std::min(i, j), b = a + 1;
+
+    if(polish[a] < 0) {
+        //The operand moved from `a` to `b`. Its old operator's parent keeps node `b`
+        int X = left[b];
+        int start = firstLeaf(X);
+        if(start == 0 || parent[b] == -1)
+            return isValid = false;
+        int Y = start - 1;
+        relink(parent[Y], Y, a);
+        left[a] = Y;
+        right[a] = X;
+        parent[Y] = a;
+        parent[X] = a;
+        setLeaf(polish, b);
+        resizeUp(polish, a);
+        resizeUp(polish, b);
+    } else {
+        //The operand moved from `b` to `a`, and the operator's old parent takes Y
+        int Y = left[a], X = right[a];
+        if(parent[a] == -1)
+            return isValid = false;
+        relink(parent[a], a, Y);
+        setLeaf(polish, a);
+        left[b] = X;
+        right[b] = a;
+        parent[X] = b;
+        parent[a] = b;
+        resizeUp(polish, a);
+        resizeUp(polish, parent[Y]);
+    }
+
+    place(polish, true);
+    remeasureMoved();
+    finish();
+    return true;
+}
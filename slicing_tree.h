@@ -0,0 +1,109 @@
+#ifndef SLICING_TREE_H
+#define SLICING_TREE_H
+#include <vector>
+#include "module.h"
+
+/* Evaluates a polish expression directly as a slicing tree. Bounding boxes are
+ * built bottom-up over the postfix expression, then every cell is placed
+ * top-down at the lower left of its leaf, and the wire length is summed over
+ * the cells' centers. Both passes are linear, so a whole evaluation costs
+ * O(n + pins) instead of the O(n^3) of shortest paths over an adjacency graph.
+ *
+ * The tree, subtree sizes, cell centers and net lengths are kept, so after one
+ * of the floorplan mutations only the path from the changed nodes to the root
+ * is resized, only subtrees that moved are placed again, and only the nets of
+ * moved cells are measured again.
+ *
+ * Operands are gate numbers from 0, where gate k is gate k+2 of the module
+ * (0 and 1 are its I/O gates). H places its two operands side by side along
+ * the gates' lengths, and V stacks them along the gates' widths, the same way
+ * the adjacency graph measures H and V neighbors. */
+
+//Operator tokens of an integer polish expression
+enum : int { POLISH_H = -1, POLISH_V = -2 };
+
+//How the wires between placed cells are measured
+enum class WireMetric
+{
+    Connections,    //sum(i,j) cij * dij, over the Manhattan distance between centers
+    HalfPerimeter   //Half perimeter of the bounding box of each net's cells
+};
+
+//Cost of a floorplan, broken down
+struct slicing_cost
+{
+    long area = 0;          //Area of the floorplan's bounding box
+    long wirelength = 0;    //Wire length by the chosen WireMetric
+};
+
+class SlicingTree
+{
+public:
+    /* Evaluates `polish` over the gates of `m`, which must outlive the tree.
+     * Returns false, leaving the cost at 0, if the polish is not a valid
+     * expression over the module's gates */
+    bool evaluate(const std::vector<int>& polish, const module& m, WireMetric metric);
+
+    /* Updates the last valid evaluation after a change to `polish`. Each returns
+     * false if the tree can not follow the change, and needs a full evaluate */
+
+    //The operands at positions i and j were swapped
+    bool swapLeaves(const std::vector<int>& polish, int i, int j);
+
+    //The operators at positions [first, last) were complemented
+    bool complementOperators(const std::vector<int>& polish, int first, int last);
+
+    //The adjacent operand and operator at positions i and j were swapped
+    bool swapOperandOperator(const std::vector<int>& polish, int i, int j);
+
+    //Whether the last evaluation or update gave a valid slicing tree
+    bool valid() const { return isValid; }
+
+    //Cost of the last valid evaluation
+    const slicing_cost& cost() const { return result; }
+
+private:
+    const module* m = nullptr;
+    WireMetric metric = WireMetric::Connections;
+    bool isValid = false;
+
+    //Node i is the token at position i of the polish. Operators have two children
+    std::vector<int> left, right, parent;
+
+    //Bounding box size and lower left corner of each node
+    std::vector<float> w, h, x, y;
+
+    //Polish position of each gate's leaf, and the gate's center
+    std::vector<int> leaf;
+    std::vector<float> cx, cy;
+
+    //Length of each net for HalfPerimeter, and the total wire length
+    std::vector<double> netLength;
+    double length = 0;
+
+    slicing_cost result;
+
+    //Scratch space of the passes, kept to save allocations
+    struct pending { int node; float x, y; };
+    std::vector<int> stack;
+    std::vector<pending> toPlace;
+    std::vector<char> dirty;            //Node resized or relinked since it was last placed
+    std::vector<int> moved;             //Gates whose center changed while placing
+    std::vector<char> isMoved;
+    std::vector<float> oldX, oldY;      //Center of each moved gate before it moved
+    std::vector<int> touched;           //Nets of moved gates
+    std::vector<char> isTouched;
+
+    bool build(const std::vector<int>& polish);
+    void setLeaf(const std::vector<int>& polish, int node);
+    void resizeUp(const std::vector<int>& polish, int node);
+    void place(const std::vector<int>& polish, bool track);
+    double netHalfPerimeter(int net) const;
+    void measure();
+    void remeasureMoved();
+    void finish();
+    int firstLeaf(int node) const;
+    void relink(int parentNode, int from, int to);
+};
+
+#endif
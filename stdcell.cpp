@@ -1,6 +1,6 @@
 #include <iostream>
-#include <sstream>
-#include <fstream>
+#include <algorithm>
+#include <cstring>
 #include <exception>
 #include <ciso646>
 #include "utility.h"
@@ -9,67 +9,196 @@
 std::ostream& operator<<(std::ostream& os, const stdcell& d)
 {
     os << d.name   << " " << d.length << " " << d.width << " " 
-       << d.inputs << " " << d.outputs;
+       << netNames(d.inputs) << " " << netNames(d.outputs);
     return os;
 }
 
-MattCellFile::MattCellFile(const std::string& filename)
+MattCellFile::MattCellFile(const std::string& filename, bool useMmap)
     : cellfilename(filename)
 {
-    int linesRead = 0;
-    std::ifstream file(filename);
-    cells.clear();
+    MappedFile file(filename, useMmap);
     
-    if(file.is_open())
+    if(file.isOpen())
     {
-        std::string line;
-        while(std::getline(file, line))
+        //Tokens of each line point into the file, and the vector is reused for every line
+        LineTokenizer lines(file.begin(), file.end());
+        std::vector<string_ref> tokens;
+        int linesRead = 0, lineCount;
+        while(lines.next(tokens, lineCount))
         {
-            ++linesRead;
-            if(line.substr(0,5) != ".cell")
+            linesRead += lineCount;
+            if(tokens.empty() || !(tokens[0] == ".cell"))
                 continue;
-            std::stringstream ss(line);
             stdcell cell;
-            readCell(ss, cell, linesRead);
-            cells[cell.name] = cell;
+            readCell(tokens, cell, linesRead);
+            addCell(cell);
         }
     } else {
         error("Could not open standard cell file \"", filename, "\"");
     }
 }
 
+MattCellFile::MattCellFile(const std::string& filename, const std::vector<stdcell>& definitions)
+    : cellfilename(filename)
+{
+    for(const stdcell& cell : definitions)
+        addCell(cell);
+}
+
+MattCellFile::MattCellFile(const std::string& name, const stdcell_definition* table, size_t count)
+    : cellfilename(name)
+{
+    std::vector<string_ref> tokens;
+    for(size_t i = 0; i != count; ++i) {
+        stdcell cell;
+        cell.name   = table[i].name;
+        cell.width  = table[i].width;
+        cell.length = table[i].length;
+
+        const char* pinText = table[i].pins;
+        int lineCount;
+        LineTokenizer(pinText, pinText + std::strlen(pinText)).next(tokens, lineCount);
+        readPins(tokens, 0, cell, i+1);
+        addCell(cell);
+    }
+}
+
+std::vector<stdcell> MattCellFile::definitions() const
+{
+    return cells;
+}
+
 const stdcell& MattCellFile::operator[](const std::string& cell_name) const
 {
-    if(cells.find(cell_name) == cells.end()) {
+    return cells[index(cell_name)];
+}
+
+int MattCellFile::index(const string_ref& cell_name) const
+{
+    int i = find(cell_name);
+    if(i == -1) {
         error("Standard cell \"", cell_name, "\" does not exist in \"", cellfilename, "\"");
     }
-    return cells.at(cell_name);
+    return i;
+}
+
+const stdcell& MattCellFile::at(int index) const
+{
+    return cells[index];
 }
 
-void MattCellFile::readCell(std::istream& is, stdcell& d, int lineNumber)
+int MattCellFile::size() const
 {
-    //ignore to skip .cell in the beginning
-    is.ignore(5) >> d.name >> d.width >> d.length;
+    return cells.size();
+}
+
+const std::string& MattCellFile::name(int index) const
+{
+    static const std::string inputs = "inputs", outputs = "outputs";
+    if(index == CELL_INPUTS)
+        return inputs;
+    if(index == CELL_OUTPUTS)
+        return outputs;
+    return cells[index].name;
+}
 
-    while(not is.eof())
+bool MattCellFile::findPin(int index, netid pin, stdcell_pin& result) const
+{
+    //Cells have a handful of pins, so a scan of the flat list is fastest
+    for(const auto& entry : pins[index]) {
+        if(entry.first == pin) {
+            result = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+int MattCellFile::find(const string_ref& cell_name) const
+{
+    if(slots.empty())
+        return -1;
+    size_t mask = slots.size() - 1;
+    for(size_t slot = string_ref_hash()(cell_name) & mask; slots[slot] != -1; slot = (slot + 1) & mask) {
+        if(cells[slots[slot]].name == cell_name)
+            return slots[slot];
+    }
+    return -1;
+}
+
+void MattCellFile::addCell(const stdcell& cell)
+{
+    int existing = find(string_ref(cell.name.data(), cell.name.size()));
+    int i = existing;
+    if(existing == -1) {
+        i = cells.size();
+        cells.push_back(cell);
+        pins.emplace_back();
+    } else {
+        cells[i] = cell;
+        pins[i].clear();
+    }
+
+    //Precompute the direction and position of each pin. Outputs first, so they win a name clash
+    for(unsigned p = 0; p != cell.outputs.size(); ++p)
+        pins[i].push_back(std::make_pair(cell.outputs[p], stdcell_pin{ true, int(p) }));
+    for(unsigned p = 0; p != cell.inputs.size(); ++p)
+        pins[i].push_back(std::make_pair(cell.inputs[p], stdcell_pin{ false, int(p) }));
+
+    if(existing != -1)
+        return;
+
+    //Linear probing insert of a cell index into the hash index
+    auto insertSlot = [this](int c) {
+        size_t mask = slots.size() - 1;
+        size_t slot = string_ref_hash()(string_ref(cells[c].name.data(), cells[c].name.size())) & mask;
+        while(slots[slot] != -1)
+            slot = (slot + 1) & mask;
+        slots[slot] = c;
+    };
+
+    //Keep the hash index at most half full, rebuilding it when it grows
+    if(cells.size() * 2 > slots.size()) {
+        slots.assign(std::max<size_t>(16, slots.size() * 2), -1);
+        for(unsigned c = 0; c != cells.size(); ++c)
+            insertSlot(c);
+    } else {
+        insertSlot(i);
+    }
+}
+
+void MattCellFile::readCell(const std::vector<string_ref>& tokens, stdcell& d, int lineNumber)
+{
+    //tokens[0] is the .cell in the beginning
+    if(tokens.size() < 4) {
+        error(cellfilename, ":", lineNumber, ": ", "Standard cell line is missing a name, width or length");
+    }
+    d.name   = tokens[1].str();
+    d.width  = toFloat(tokens[2]);
+    d.length = toFloat(tokens[3]);
+    readPins(tokens, 4, d, lineNumber);
+}
+
+void MattCellFile::readPins(const std::vector<string_ref>& tokens, unsigned first, stdcell& d, int lineNumber)
+{
+    for(unsigned i = first; i < tokens.size(); ++i)
     {
-        std::string s;
-        is >> s;
+        const string_ref& s = tokens[i];
         size_t dotPos = s.find('.');
-        std::string name = s.substr(0, dotPos);
+        string_ref name = s.substr(0, dotPos);
         
         if(name.empty()) {
             error(cellfilename, ":", lineNumber, ": ",
                 "Standard cell \"", d.name, "\" has empty pin name (", s, ")");
         }
-        else if(s.find(".I") != std::string::npos) {
-            d.inputs.push_back(name);
+        else if(s.substr(dotPos, 2) == ".I") {
+            d.inputs.push_back(nets().intern(name));
         }
-        else if(s.find(".O") != std::string::npos) {
-            d.outputs.push_back(name);
+        else if(s.substr(dotPos, 2) == ".O") {
+            d.outputs.push_back(nets().intern(name));
         }
         else {
-            std::string io = (dotPos != std::string::npos) ? s.substr(dotPos) : "empty";
+            string_ref io = (dotPos != std::string::npos) ? s.substr(dotPos) : string_ref("empty", 5);
             error(cellfilename, ":", lineNumber, ": ",
                 "Standard cell \"", d.name, "\" pin \"", s, "\" has invalid I/O specifier (", io, ")");
         }
@@ -78,7 +207,7 @@ void MattCellFile::readCell(std::istream& is, stdcell& d, int lineNumber)
 
 std::ostream& operator<<(std::ostream& os, const MattCellFile& mc)
 {
-    for(const auto& entry : mc.cells)
-        os << entry.first << " -> " << entry.second << std::endl;
+    for(const stdcell& cell : mc.cells)
+        os << cell.name << " -> " << cell << std::endl;
     return os;
 }
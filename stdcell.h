@@ -2,16 +2,31 @@
 #define STD_CELL_H
 
 #include <vector>
-#include <map>
 #include <string>
+#include "utility.h"
+#include "nettable.h"
 
 struct stdcell
 {
     std::string name;
     float width = 0;
     float length = 0;
-    std::vector<std::string> inputs;
-    std::vector<std::string> outputs;
+    std::vector<netid> inputs;     //Nets (or pin names, for library cells) in nets()
+    std::vector<netid> outputs;
+};
+
+//Cells of a module's I/O pseudo-gates, which are in no cell library
+enum : int { CELL_INPUTS = -2, CELL_OUTPUTS = -3 };
+
+/* A gate instance in a module. Its standard cell is referred to by the cell's
+ * index in the MattCellFile the module was read with, and the cell's width and
+ * length are kept in the module's geometry arrays, so an instance only holds
+ * what differs between instances */
+struct gate_instance
+{
+    int cell = -1;
+    std::vector<netid> inputs;
+    std::vector<netid> outputs;
 };
 
 //stdcell output operator
@@ -19,8 +34,25 @@ std::ostream& operator<<(std::ostream& os, const stdcell& d);
 
 /******************************************************************/
 
+//Direction and position of a pin in a standard cell's inputs or outputs
+struct stdcell_pin
+{
+    bool output;
+    int  index;
+};
+
+//A standard cell definition compiled into the program. See usf_ami05_cells.h
+struct stdcell_definition
+{
+    const char* name;
+    float width;
+    float length;
+    const char* pins;   //Pins as written in a cell file, eg: "a.I b.I O.O"
+};
+
 /* Class to hold a standard cell library from a Matt Cell File
- * into a map, indexed by name.
+ * in a flat table, with an open addressing hash index by name, and
+ * a precomputed pin lookup for each cell.
  * Overloaded [] operator to access stdcell structures.
  * See `stdcell_test.cpp` for usage
  */
@@ -28,21 +60,56 @@ std::ostream& operator<<(std::ostream& os, const stdcell& d);
 class MattCellFile
 {
 public:
-    //Construct and load cell definitions from a file
-    MattCellFile(const std::string& filename);
+    //Construct and load cell definitions from a file, memory mapped unless `useMmap` is false
+    MattCellFile(const std::string& filename, bool useMmap = true);
+
+    //Construct from cell definitions that were already loaded from `filename`
+    MattCellFile(const std::string& filename, const std::vector<stdcell>& definitions);
+
+    //Construct from `count` cell definitions compiled into the program
+    MattCellFile(const std::string& name, const stdcell_definition* table, size_t count);
 
     //Lookup a standard cell definition by name
     const stdcell& operator[](const std::string& cell_name) const;
 
+    //Index of a standard cell by name, for at() and findPin(). Errors if it does not exist
+    int index(const string_ref& cell_name) const;
+
+    //Standard cell definition at `index`
+    const stdcell& at(int index) const;
+
+    //Number of standard cells
+    int size() const;
+
+    //Name of the cell at `index`, or "inputs"/"outputs" for CELL_INPUTS/CELL_OUTPUTS
+    const std::string& name(int index) const;
+
+    //Looks up pin `pin` of the cell at `index`. Returns false if the cell has no such pin
+    bool findPin(int index, netid pin, stdcell_pin& result) const;
+
+    //All cell definitions, in the order they were defined
+    std::vector<stdcell> definitions() const;
+
 private:
     //Output operator
     friend std::ostream& operator<<(std::ostream& os, const MattCellFile& mc);
     
-    //Parses a stdcell from a line
-    void readCell(std::istream& is, stdcell& d, int lineNumber);
+    //Parses a stdcell from the tokens of a line
+    void readCell(const std::vector<string_ref>& tokens, stdcell& d, int lineNumber);
+
+    //Parses the "name.I" and "name.O" pins in tokens [first, end) into d
+    void readPins(const std::vector<string_ref>& tokens, unsigned first, stdcell& d, int lineNumber);
+
+    //Adds a cell to the table, replacing any cell with the same name
+    void addCell(const stdcell& cell);
+
+    //Index of the cell named `cell_name`, or -1
+    int find(const string_ref& cell_name) const;
 
     //Data members
-    std::map<std::string, stdcell> cells;
+    std::vector<stdcell> cells;
+    std::vector<std::vector<std::pair<netid,stdcell_pin>>> pins;  //Pin lookup for each cell
+    std::vector<int> slots;     //Hash index of names into `cells`, -1 for an empty slot
     std::string cellfilename;
 };
 
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <chrono>
+#include "threadpool.h"
+
+//The pool and queue index of the calling thread, if it is a worker
+static thread_local ThreadPool* workerPool  = nullptr;
+static thread_local unsigned    workerIndex = 0;
+
+ThreadPool::ThreadPool(unsigned threads)
+    : queued(0), nextQueue(0), stopping(false)
+{
+    threads = std::max(1u, threads);
+    for(unsigned i = 0; i != threads; ++i)
+        queues.emplace_back(new taskqueue);
+    for(unsigned i = 0; i != threads; ++i)
+        workers.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(std::thread& t : workers)
+        t.join();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    unsigned q = (workerPool == this) ? workerIndex : nextQueue++ % queues.size();
+    {
+        std::lock_guard<std::mutex> guard(queues[q]->lock);
+        queues[q]->tasks.push_back(std::move(task));
+    }
+
+    //Taking the sleep lock orders this with a worker checking `queued` before it sleeps
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        queued += 1;
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::pop(unsigned self, std::function<void()>& task)
+{
+    //Newest task of our own queue first, for locality
+    {
+        taskqueue& own = *queues[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if(!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued -= 1;
+            return true;
+        }
+    }
+
+    //Then steal the oldest task of another queue, which tends to be the biggest
+    for(unsigned i = 1; i != queues.size(); ++i) {
+        taskqueue& other = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(other.lock);
+        if(!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            queued -= 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runOne()
+{
+    std::function<void()> task;
+    unsigned self = (workerPool == this) ? workerIndex : 0;
+    if(queued == 0 || !pop(self, task))
+        return false;
+    task();
+    return true;
+}
+
+unsigned ThreadPool::size() const
+{
+    return workers.size();
+}
+
+void ThreadPool::work(unsigned self)
+{
+    workerPool  = this;
+    workerIndex = self;
+    while(1)
+    {
+        std::function<void()> task;
+        if(pop(self, task)) {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(sleepLock);
+        wake.wait(guard, [this]() { return stopping || queued > 0; });
+        if(stopping)
+            return;
+    }
+}
+
+ThreadPool& threadPool()
+{
+    static ThreadPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
+
+/******************************************************************/
+
+TaskGroup::TaskGroup(ThreadPool& pool)
+    : pool(pool), pending(0)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    //Tasks refer to the group, so it must outlive them even when unwinding
+    try {
+        wait();
+    } catch(...) {
+    }
+}
+
+void TaskGroup::run(std::function<void()> task)
+{
+    pending += 1;
+    pool.submit([this, task]() {
+        try {
+            task();
+        } catch(...) {
+            std::lock_guard<std::mutex> guard(lock);
+            if(!firstError)
+                firstError = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        if(--pending == 0)
+            finished.notify_all();
+    });
+}
+
+void TaskGroup::wait()
+{
+    while(pending > 0) {
+        if(pool.runOne())
+            continue;
+
+        //Nothing to help with; sleep until the group is done or more work may have been queued
+        std::unique_lock<std::mutex> guard(lock);
+        finished.wait_for(guard, std::chrono::milliseconds(1), [this]() { return pending == 0; });
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::swap(error, firstError);
+    }
+    if(error)
+        std::rethrow_exception(error);
+}
@@ -0,0 +1,83 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <thread>
+
+/* Work-stealing thread pool. Every worker has its own queue of tasks: a worker
+ * runs the newest task of its own queue first, and steals the oldest task of
+ * another queue when its own is empty. Tasks submitted from a worker go on that
+ * worker's queue, so recursive work stays on one core until others go idle */
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //Queues `task` to be run by some thread of the pool
+    void submit(std::function<void()> task);
+
+    //Runs one queued task on the calling thread. Returns false if there was none
+    bool runOne();
+
+    //Number of worker threads
+    unsigned size() const;
+
+private:
+    struct taskqueue
+    {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<taskqueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<int>      queued;     //Tasks waiting in all queues
+    std::atomic<unsigned> nextQueue;  //Queue for the next task submitted from outside the pool
+    std::mutex            sleepLock;
+    std::condition_variable wake;
+    bool                  stopping;
+
+    bool pop(unsigned self, std::function<void()>& task);
+    void work(unsigned self);
+};
+
+//The pool shared by partitioning and floorplanning, sized to the hardware
+ThreadPool& threadPool();
+
+/* A set of tasks that can be waited on together. A thread waiting on a group
+ * runs queued tasks of the pool meanwhile, so tasks may wait on groups of their
+ * own without tying up the pool. The first exception thrown by a task of the
+ * group is rethrown by `wait` */
+
+class TaskGroup
+{
+public:
+    explicit TaskGroup(ThreadPool& pool = threadPool());
+    ~TaskGroup();
+
+    //Runs `task` on the pool as part of this group
+    void run(std::function<void()> task);
+
+    //Waits for every task of the group to finish
+    void wait();
+
+private:
+    ThreadPool&             pool;
+    std::atomic<int>        pending;
+    std::exception_ptr      firstError;
+    std::mutex              lock;
+    std::condition_variable finished;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef USF_AMI05_CELLS_H
+#define USF_AMI05_CELLS_H
+#include "stdcell.h"
+
+/* The USF AMI05 standard cell library (files/usf_ami05_std_cells.lib) compiled
+ * into the program, for flows that always use it. Load it with:
+ *   MattCellFile cells("usf_ami05", usf_ami05_cells, usf_ami05_cell_count); */
+
+constexpr stdcell_definition usf_ami05_cells[] =
+{
+    //Name       W   L        Pins
+    { "inv",     30, 7.2f,   "a.I O.O" },
+    { "buf",     30, 12.0f,  "a.I O.O" },
+    { "and1",    30, 16.8f,  "a.I O.O" },
+    { "and2",    30, 16.8f,  "a.I b.I O.O" },
+    { "and3",    30, 19.2f,  "a.I b.I c.I O.O" },
+    { "and4",    30, 21.6f,  "a.I b.I c.I d.I O.O" },
+    { "or1",     30, 15.9f,  "a.I O.O" },
+    { "or2",     30, 15.9f,  "a.I b.I O.O" },
+    { "or3",     30, 19.2f,  "a.I b.I c.I O.O" },
+    { "or4",     30, 21.6f,  "a.I b.I c.I d.I O.O" },
+    { "nand1",   30, 9.6f,   "a.I b.I O.O" },
+    { "nand2",   30, 9.6f,   "a.I b.I O.O" },
+    { "nand3",   30, 12.0f,  "a.I b.I c.I O.O" },
+    { "nand4",   30, 14.4f,  "a.I b.I c.I d.I O.O" },
+    { "nor1",    30, 8.7f,   "a.I O.O" },
+    { "nor2",    30, 8.7f,   "a.I b.I O.O" },
+    { "nor3",    30, 12.0f,  "a.I b.I c.I O.O" },
+    { "nor4",    30, 14.4f,  "a.I b.I c.I d.I O.O" },
+    { "aoi21",   30, 12.0f,  "a.I b.I c.I O.O" },
+    { "aoi22",   30, 14.4f,  "a.I b.I c.I d.I O.O" },
+    { "aoi33",   30, 19.2f,  "a.I b.I c.I d.I e.I f.I O.O" },
+    { "mux2",    30, 28.8f,  "a.I b.I s.I O.O" },
+    { "xor2",    30, 31.2f,  "a.I b.I O.O" },
+    { "xnor2",   30, 38.4f,  "a.I b.I O.O" },
+    { "fa",      30, 67.2f,  "a.I b.I ci.I s.O co.O" },
+    { "mc",      30, 25.2f,  "a.I b.I altb.O agtb.O" },
+    { "dff",     30, 72.0f,  "set.I rst.I clk.I d.I q.O qb.O" },
+    { "jkff",    30, 88.8f,  "set.I rst.I clk.I j.I k.I q.O qb.O" },
+    { "tff",     30, 88.8f,  "set.I rst.I clk.I t.I q.O qb.O" },
+};
+
+constexpr size_t usf_ami05_cell_count = sizeof(usf_ami05_cells) / sizeof(usf_ami05_cells[0]);
+
+#endif
@@ -1,3 +1,14 @@
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "utility.h"
 
 std::vector<std::string> Split(const std::string& target, const std::string& delims)
@@ -53,3 +64,191 @@ std::istream& getline_fixed(std::istream& is, std::string& line, int& lineCount)
     lineCount = 0;
     return getline_fixed_recursive(is, line, false, lineCount);
 }
+
+/******************************************************************/
+
+size_t string_ref::find(char c, size_t pos) const
+{
+    if(pos >= size)
+        return std::string::npos;
+    const void* found = std::memchr(data + pos, c, size - pos);
+    return found ? static_cast<const char*>(found) - data : std::string::npos;
+}
+
+string_ref string_ref::substr(size_t pos, size_t n) const
+{
+    pos = std::min(pos, size);
+    return string_ref(data + pos, std::min(n, size - pos));
+}
+
+bool operator==(const string_ref& a, const string_ref& b)
+{
+    return a.size == b.size && std::memcmp(a.data, b.data, a.size) == 0;
+}
+
+bool operator==(const string_ref& a, const std::string& b)
+{
+    return a == string_ref(b.data(), b.size());
+}
+
+bool operator==(const std::string& a, const string_ref& b)
+{
+    return b == a;
+}
+
+bool operator==(const string_ref& a, const char* b)
+{
+    return a == string_ref(b, std::strlen(b));
+}
+
+std::ostream& operator<<(std::ostream& os, const string_ref& s)
+{
+    return os.write(s.data, s.size);
+}
+
+size_t string_ref_hash::operator()(const string_ref& s) const
+{
+    //FNV-1a
+    unsigned long long hash = 14695981039346656037ULL;
+    for(size_t i = 0; i != s.size; ++i) {
+        hash ^= static_cast<unsigned char>(s.data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+float toFloat(const string_ref& s, float fallback)
+{
+    //Tokens are not null terminated, so copy to a small buffer for strtof
+    char buffer[64];
+    if(s.empty() || s.size >= sizeof(buffer))
+        return fallback;
+    std::memcpy(buffer, s.data, s.size);
+    buffer[s.size] = '\0';
+    char* parsedEnd;
+    float value = std::strtof(buffer, &parsedEnd);
+    return (parsedEnd == buffer + s.size) ? value : fallback;
+}
+
+/******************************************************************/
+
+MappedFile::MappedFile(const std::string& filename, bool useMmap)
+{
+#ifndef _WIN32
+    if(useMmap) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd == -1)
+            return;
+        struct stat st;
+        if(::fstat(fd, &st) == 0) {
+            opened = true;
+            length = st.st_size;
+            if(length != 0) {
+                void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(p != MAP_FAILED) {
+                    ::madvise(p, length, MADV_SEQUENTIAL);
+                    data = static_cast<const char*>(p);
+                    mapped = true;
+                }
+            }
+        }
+        ::close(fd);
+        if(mapped || (opened && length == 0))
+            return;
+        opened = false;
+    }
+#else
+    (void)useMmap;
+#endif
+
+    //Fallback: read the whole file into a buffer
+    std::ifstream file(filename, std::ios::binary);
+    if(!file.is_open())
+        return;
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data = buffer.data();
+    length = buffer.size();
+    opened = true;
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if(mapped)
+        ::munmap(const_cast<char*>(data), length);
+#endif
+}
+
+bool MappedFile::isOpen() const
+{
+    return opened;
+}
+
+const char* MappedFile::begin() const
+{
+    return data;
+}
+
+const char* MappedFile::end() const
+{
+    return data + length;
+}
+
+/******************************************************************/
+
+static bool isTokenEnd(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#' || c == '\\';
+}
+
+LineTokenizer::LineTokenizer(const char* begin, const char* end)
+    : pos(begin)
+    , last(end)
+    { }
+
+bool LineTokenizer::next(std::vector<string_ref>& tokens, int& lineCount)
+{
+    tokens.clear();
+    lineCount = 0;
+    if(pos == last)
+        return false;
+
+    bool joinNext = false;
+    while(pos != last)
+    {
+        char c = *pos;
+        if(c == '\n') {
+            ++pos;
+            ++lineCount;
+            if(!joinNext)
+                return true;
+            joinNext = false;
+        }
+        else if(c == ' ' || c == '\t' || c == '\r') {
+            ++pos;
+        }
+        else if(c == '#' || c == '\\') {
+            //Skip a comment or everything after a line continuation
+            if(c == '\\')
+                joinNext = true;
+            const void* newline = std::memchr(pos, '\n', last - pos);
+            pos = newline ? static_cast<const char*>(newline) : last;
+        }
+        else {
+            const char* start = pos;
+            do {
+                ++pos;
+            } while(pos != last && !isTokenEnd(*pos));
+            tokens.push_back(string_ref(start, pos - start));
+        }
+    }
+
+    //Last line without a newline at the end
+    ++lineCount;
+    return true;
+}
+
+const char* LineTokenizer::position() const
+{
+    return pos;
+}
@@ -5,6 +5,11 @@
 #include <stdexcept>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 /* Improved Split funtion that skips over consecutive delimiters, 
  * and splits on more than one delimiter (Used for space and tab) */
@@ -21,6 +26,86 @@ void removeComments(std::string& s);
  * of lines read into `lineCount` */
 std::istream& getline_fixed(std::istream& is, std::string& line, int& lineCount);
 
+/* Non-owning reference to a range of characters. Used to tokenize files
+ * in place without copying every token into its own std::string */
+struct string_ref
+{
+    const char* data;
+    size_t size;
+
+    string_ref() : data(nullptr), size(0) { }
+    string_ref(const char* d, size_t n) : data(d), size(n) { }
+    string_ref(const char* s) : data(s), size(std::char_traits<char>::length(s)) { }
+    string_ref(const std::string& s) : data(s.data()), size(s.size()) { }
+
+    bool empty() const { return size == 0; }
+    std::string str() const { return std::string(data, size); }
+
+    //Same meaning as the std::string functions, returning std::string::npos if not found
+    size_t find(char c, size_t pos = 0) const;
+    string_ref substr(size_t pos, size_t n = std::string::npos) const;
+};
+
+bool operator==(const string_ref& a, const string_ref& b);
+bool operator==(const string_ref& a, const std::string& b);
+bool operator==(const std::string& a, const string_ref& b);
+bool operator==(const string_ref& a, const char* b);
+std::ostream& operator<<(std::ostream& os, const string_ref& s);
+
+//Hash of a string_ref's characters, for hashed containers keyed by string_ref
+struct string_ref_hash
+{
+    size_t operator()(const string_ref& s) const;
+};
+
+//Parses a float from a token, or returns `fallback` if it is not a number
+float toFloat(const string_ref& s, float fallback = 0);
+
+/* Read-only view of a whole file's contents. The file is memory mapped when
+ * `useMmap` is set and the platform supports it, otherwise it is read into
+ * a buffer. Check isOpen() after construction, like an std::ifstream */
+class MappedFile
+{
+public:
+    MappedFile(const std::string& filename, bool useMmap = true);
+    ~MappedFile();
+
+    bool isOpen() const;
+    const char* begin() const;
+    const char* end() const;
+
+private:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    bool opened = false;
+    std::vector<char> buffer;
+};
+
+/* Splits a range of characters into logical lines of whitespace separated tokens.
+ * Like getline_fixed, lines ending in "\" are joined with the next line and #
+ * comments are removed, but tokens point into the range instead of being copied.
+ * `tokens` is reused between lines, so no allocation happens once it has grown */
+class LineTokenizer
+{
+public:
+    LineTokenizer(const char* begin, const char* end);
+
+    //Reads the next logical line into `tokens`, and the number of lines read into
+    //`lineCount`. Returns false when there are no more lines
+    bool next(std::vector<string_ref>& tokens, int& lineCount);
+
+    //Start of the next line to be read
+    const char* position() const;
+
+private:
+    const char* pos;
+    const char* last;
+};
+
 //roger - use this for printing a string on a single line
 template <typename printType>
 void println(printType const &str)
@@ -57,6 +142,40 @@ operator<<(std::ostream& os, const T& cntr)
     return os;
 }
 
+/* Calls fn(i) for each i in [0, count) using one thread per hardware core.
+ * Threads take the next index as they finish, so uneven work is balanced.
+ * The first exception thrown by `fn` is rethrown once all threads have finished */
+template<typename Function>
+void parallelFor(unsigned count, Function fn)
+{
+    std::atomic<unsigned> nextIndex(0);
+    std::exception_ptr firstError;
+    std::mutex errorLock;
+
+    auto worker = [&]() {
+        for(unsigned i = nextIndex++; i < count; i = nextIndex++) {
+            try {
+                fn(i);
+            } catch(...) {
+                std::lock_guard<std::mutex> guard(errorLock);
+                if(!firstError)
+                    firstError = std::current_exception();
+            }
+        }
+    };
+
+    unsigned nThreads = std::min(count, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for(unsigned t = 1; t < nThreads; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for(std::thread& t : threads)
+        t.join();
+
+    if(firstError)
+        std::rethrow_exception(firstError);
+}
+
 //Used to format strings into a runtime_error.
 //See http://en.cppreference.com/w/cpp/language/parameter_pack
 template<typename... Ts>